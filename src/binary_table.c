@@ -0,0 +1,266 @@
+// Needed for mmap(2) and fstat(2)
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary_table.h"
+#include "hash.h"
+#include "utils.h"
+
+static u64
+round_up_to_page(const u64 offset, const u64 page_size)
+{
+    return (offset + page_size - 1) / page_size * page_size;
+}
+
+static void
+get_array_sizes(const binary_table_header *header, u64 *sizes)
+{
+    const u64 size = (u64)header->n_rho * header->n_temperature * header->n_ye;
+    sizes[0]       = sizeof(f64) * header->n_rho;
+    sizes[1]       = sizeof(f64) * header->n_temperature;
+    sizes[2]       = sizeof(f64) * header->n_ye;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        sizes[3 + n] = sizeof(f64) * size;
+    }
+}
+
+static void
+get_table_arrays(const stellar_collapse_eos *table, f64 **arrays)
+{
+    arrays[0] = table->log10_rho;
+    arrays[1] = table->log10_temperature;
+    arrays[2] = table->ye;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        arrays[3 + n] = table->data[n];
+    }
+}
+
+static void
+set_table_arrays(stellar_collapse_eos *table, f64 *const *arrays)
+{
+    table->log10_rho         = arrays[0];
+    table->log10_temperature = arrays[1];
+    table->ye                = arrays[2];
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        table->data[n] = arrays[3 + n];
+    }
+}
+
+static u64
+binary_table_checksum(const binary_table_header *header, f64 *const *arrays, const u64 *sizes)
+{
+    binary_table_header unsummed = *header;
+    unsummed.checksum            = 0;
+
+    u64 words[BINARY_TABLE_N_ARRAYS];
+    for(int k = 0; k < BINARY_TABLE_N_ARRAYS; k++) {
+        words[k] = parallel_hash(arrays[k], sizes[k], 0);
+    }
+    return xxh64(words, sizeof(words), xxh64(&unsummed, sizeof(unsummed), 0));
+}
+
+static void
+validate_binary_table_header(const binary_table_header *header, const u64 file_size, const char *filepath)
+{
+    if(memcmp(header->magic, BINARY_TABLE_MAGIC, sizeof(header->magic)) != 0) {
+        error(INVALID_FILE_FORMAT, "File '%s' is not a binary EOS table\n", filepath);
+    }
+    if(header->version != BINARY_TABLE_VERSION || header->byte_order != BINARY_TABLE_BYTE_ORDER) {
+        error(
+            INVALID_FILE_FORMAT,
+            "Binary table '%s' has version %u and byte order 0x%08x, but only version %d in native byte order is "
+            "supported\n",
+            filepath,
+            header->version,
+            header->byte_order,
+            BINARY_TABLE_VERSION
+        );
+    }
+    if(header->n_quantities != number_of_eos_quantities || header->n_rho < 1 || header->n_temperature < 1
+       || header->n_ye < 1 || header->page_size == 0 || header->file_size != file_size) {
+        error(INVALID_FILE_FORMAT, "Binary table '%s' has an invalid header or is truncated\n", filepath);
+    }
+
+    u64 sizes[BINARY_TABLE_N_ARRAYS];
+    get_array_sizes(header, sizes);
+    for(int k = 0; k < BINARY_TABLE_N_ARRAYS; k++) {
+        if(header->offsets[k] % header->page_size != 0 || header->offsets[k] < sizeof(binary_table_header)
+           || header->offsets[k] > file_size || sizes[k] > file_size - header->offsets[k]) {
+            error(INVALID_FILE_FORMAT, "Array %d of binary table '%s' is misaligned or out of bounds\n", k, filepath);
+        }
+    }
+}
+
+static void
+verify_binary_table_checksum(const binary_table_header *header, f64 *const *arrays, const char *filepath)
+{
+    u64 sizes[BINARY_TABLE_N_ARRAYS];
+    get_array_sizes(header, sizes);
+    if(binary_table_checksum(header, arrays, sizes) != header->checksum) {
+        error(INVALID_FILE_FORMAT, "Checksum mismatch in binary table '%s'; the file is corrupt\n", filepath);
+    }
+}
+
+bool
+is_binary_table_file(const char *filepath)
+{
+    FILE *fp = fopen(filepath, "rb");
+    if(!fp) {
+        return false;
+    }
+    char       magic[8];
+    const bool found = fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, BINARY_TABLE_MAGIC, 8) == 0;
+    fclose(fp);
+    return found;
+}
+
+void
+write_binary_table(const stellar_collapse_eos *table, const char *filepath)
+{
+    binary_table_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_TABLE_MAGIC, sizeof(header.magic));
+    header.version       = BINARY_TABLE_VERSION;
+    header.byte_order    = BINARY_TABLE_BYTE_ORDER;
+    header.page_size     = BINARY_TABLE_PAGE_SIZE;
+    header.n_rho         = table->n_rho;
+    header.n_temperature = table->n_temperature;
+    header.n_ye          = table->n_ye;
+    header.n_quantities  = number_of_eos_quantities;
+    header.energy_shift  = table->energy_shift;
+
+    // Each array starts on a new page
+    f64 *arrays[BINARY_TABLE_N_ARRAYS];
+    u64  sizes[BINARY_TABLE_N_ARRAYS];
+    u64  offset = round_up_to_page(sizeof(header), BINARY_TABLE_PAGE_SIZE);
+    get_table_arrays(table, arrays);
+    get_array_sizes(&header, sizes);
+    for(int k = 0; k < BINARY_TABLE_N_ARRAYS; k++) {
+        header.offsets[k] = offset;
+        header.file_size  = offset + sizes[k];
+        offset            = round_up_to_page(header.file_size, BINARY_TABLE_PAGE_SIZE);
+    }
+    header.checksum = binary_table_checksum(&header, arrays, sizes);
+
+    FILE *fp = fopen(filepath, "wb");
+    if(!fp) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    // The padding before each array is written as zeros
+    static const u8 zeros[BINARY_TABLE_PAGE_SIZE];
+    bool            ok       = fwrite(&header, sizeof(header), 1, fp) == 1;
+    u64             position = sizeof(header);
+    for(int k = 0; ok && k < BINARY_TABLE_N_ARRAYS; k++) {
+        const u64 padding = header.offsets[k] - position;
+        ok                = fwrite(zeros, 1, padding, fp) == padding && fwrite(arrays[k], 1, sizes[k], fp) == sizes[k];
+        position          = header.offsets[k] + sizes[k];
+    }
+    if(fclose(fp) != 0 || !ok) {
+        error(FILE_IO_FAILED, "Could not write binary table '%s'\n", filepath);
+    }
+}
+
+stellar_collapse_eos *
+read_binary_table(const char *filepath)
+{
+    FILE *fp = fopen(filepath, "rb");
+    if(!fp) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    binary_table_header header;
+    struct stat         st;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || fstat(fileno(fp), &st) != 0) {
+        fclose(fp);
+        error(INVALID_FILE_FORMAT, "Could not read the header of binary table '%s'\n", filepath);
+    }
+    validate_binary_table_header(&header, st.st_size, filepath);
+
+    stellar_collapse_eos *table = malloc_or_error(sizeof(stellar_collapse_eos));
+    memset(table, 0, sizeof(stellar_collapse_eos));
+    table->n_rho         = header.n_rho;
+    table->n_temperature = header.n_temperature;
+    table->n_ye          = header.n_ye;
+    table->energy_shift  = header.energy_shift;
+
+    f64 *arrays[BINARY_TABLE_N_ARRAYS];
+    u64  sizes[BINARY_TABLE_N_ARRAYS];
+    get_array_sizes(&header, sizes);
+    for(int k = 0; k < BINARY_TABLE_N_ARRAYS; k++) {
+        arrays[k] = malloc_or_error(sizes[k]);
+        if(fseek(fp, header.offsets[k], SEEK_SET) != 0 || fread(arrays[k], 1, sizes[k], fp) != sizes[k]) {
+            fclose(fp);
+            error(FILE_IO_FAILED, "Could not read array %d of binary table '%s'\n", k, filepath);
+        }
+    }
+    fclose(fp);
+    set_table_arrays(table, arrays);
+
+    verify_binary_table_checksum(&header, arrays, filepath);
+    debug("Read binary table '%s' (%" PRIu64 " bytes)\n", filepath, header.file_size);
+
+    return table;
+}
+
+binary_table_map *
+map_binary_table(const char *filepath, const bool verify_checksum)
+{
+    const int fd = open(filepath, O_RDONLY);
+    if(fd < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (u64)st.st_size < sizeof(binary_table_header)) {
+        close(fd);
+        error(INVALID_FILE_FORMAT, "Could not read the header of binary table '%s'\n", filepath);
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) {
+        error(FILE_IO_FAILED, "Could not map binary table '%s'\n", filepath);
+    }
+
+    const binary_table_header *header = (const binary_table_header *)base;
+    validate_binary_table_header(header, st.st_size, filepath);
+
+    binary_table_map *map = malloc_or_error(sizeof(binary_table_map));
+    memset(map, 0, sizeof(binary_table_map));
+    map->base                = base;
+    map->size                = st.st_size;
+    map->table.n_rho         = header->n_rho;
+    map->table.n_temperature = header->n_temperature;
+    map->table.n_ye          = header->n_ye;
+    map->table.energy_shift  = header->energy_shift;
+
+    f64 *arrays[BINARY_TABLE_N_ARRAYS];
+    for(int k = 0; k < BINARY_TABLE_N_ARRAYS; k++) {
+        arrays[k] = (f64 *)((u8 *)base + header->offsets[k]);
+    }
+    set_table_arrays(&map->table, arrays);
+
+    // Hashing the arrays reads the whole file, which defeats mapping it on every rank
+    if(verify_checksum) {
+        verify_binary_table_checksum(header, arrays, filepath);
+    }
+    return map;
+}
+
+void
+unmap_binary_table(binary_table_map *map)
+{
+    if(!map) {
+        return;
+    }
+    munmap(map->base, map->size);
+    free(map);
+}
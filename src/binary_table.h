@@ -0,0 +1,96 @@
+/**
+ * @file binary_table.h
+ * @author Leo Werneck
+ *
+ * @brief Native binary format for EOS tables, which can be loaded without HDF5 or mapped directly into memory.
+ *
+ * A binary table starts with a binary_table_header, padded to BINARY_TABLE_PAGE_SIZE bytes. It is followed by the
+ * axes (log10_rho, log10_temperature, ye) and by the quantities, in the order of the stellar_collapse_eos_quantity
+ * enum. Every array holds f64 values in native byte order, in the same layout as in memory, and starts at a multiple
+ * of BINARY_TABLE_PAGE_SIZE, so that a mapped file can be used in place. The checksum covers the header and all
+ * arrays.
+ */
+#ifndef BINARY_TABLE_H
+#define BINARY_TABLE_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "stellar_collapse_eos.h"
+
+#define BINARY_TABLE_MAGIC      "EOSTABLE"                     ///< First bytes of every binary table.
+#define BINARY_TABLE_VERSION    (1)                            ///< Version of the format written by this code.
+#define BINARY_TABLE_BYTE_ORDER (0x01020304)                   ///< Written in native byte order, to detect swaps.
+#define BINARY_TABLE_PAGE_SIZE  (4096)                         ///< Alignment of the header and of every array.
+#define BINARY_TABLE_N_ARRAYS   (3 + number_of_eos_quantities) ///< Number of arrays (axes and quantities).
+#define BINARY_TABLE_EXTENSION  ".eosb"                        ///< Extension of binary tables written by the cleaner.
+
+/**
+ * @brief Header at the start of a binary table.
+ */
+typedef struct
+{
+    char magic[8];                       ///< BINARY_TABLE_MAGIC (not null-terminated).
+    u32  version;                        ///< BINARY_TABLE_VERSION.
+    u32  byte_order;                     ///< BINARY_TABLE_BYTE_ORDER, in the byte order of the machine that wrote it.
+    u64  page_size;                      ///< Alignment of the arrays.
+    i32  n_rho, n_temperature, n_ye;     ///< Number of grid points in density, temperature, and electron fraction.
+    i32  n_quantities;                   ///< Number of quantities (number_of_eos_quantities).
+    f64  energy_shift;                   ///< Energy shift applied to the specific internal energy.
+    u64  offsets[BINARY_TABLE_N_ARRAYS]; ///< Offset of each array from the start of the file, in bytes.
+    u64  file_size;                      ///< Size of the file, in bytes.
+    u64  checksum;                       ///< Checksum of the header (with this field zeroed) and of all arrays.
+} binary_table_header;
+
+/**
+ * @brief A binary table mapped into memory.
+ */
+typedef struct
+{
+    stellar_collapse_eos table; ///< The table; all arrays point into the read-only mapping and must not be modified.
+    void                *base;  ///< Start of the mapping.
+    usize                size;  ///< Size of the mapping, in bytes.
+} binary_table_map;
+
+/**
+ * @brief Returns true if the file exists and starts with BINARY_TABLE_MAGIC.
+ */
+bool is_binary_table_file(const char *filepath);
+
+/**
+ * @brief Writes a table in the binary format.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to write.
+ * @param filepath Path to the output file.
+ */
+void write_binary_table(const stellar_collapse_eos *table, const char *filepath);
+
+/**
+ * @brief Reads a binary table into newly allocated memory, verifying its checksum.
+ *
+ * @param filepath Path to the binary table.
+ *
+ * @return Pointer to the table, to be freed with free_stellar_collapse_eos_table.
+ */
+stellar_collapse_eos *read_binary_table(const char *filepath);
+
+/**
+ * @brief Maps a binary table read-only into memory, verifying its header.
+ *
+ * Nothing is copied: the arrays of the table point into the mapping, which is shared by all processes that map the
+ * same file (e.g., the ranks of a simulation on a node). Pages are only read when they are first accessed, unless the
+ * checksum is verified, which reads the whole file.
+ *
+ * @param filepath Path to the binary table.
+ * @param verify_checksum Whether to also verify the checksum of all arrays.
+ *
+ * @return Pointer to the mapped table, to be released with unmap_binary_table.
+ */
+binary_table_map *map_binary_table(const char *filepath, const bool verify_checksum);
+
+/**
+ * @brief Unmaps a table mapped by map_binary_table.
+ */
+void unmap_binary_table(binary_table_map *map);
+
+#endif // BINARY_TABLE_H
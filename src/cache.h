@@ -0,0 +1,73 @@
+/**
+ * @file cache.h
+ * @author Leo Werneck
+ *
+ * @brief Content-addressed cache of cleaning results.
+ *
+ * Entries are keyed by hashes of the input data, the options that affect the output, and the filter parameters:
+ *   - <cache_dir>/<key>.h5: the complete output of a run (only used with the default output mode and no patch).
+ *   - <cache_dir>/<key>.qty.h5: one median filtered quantity, keyed only by that quantity's input data, so a table
+ *     where some datasets changed only refilters those.
+ * Entries are written under a temporary name and renamed, so concurrent runs never see partial files.
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "cleaner.h"
+#include "options.h"
+#include "stellar_collapse_eos.h"
+
+#define CACHE_FORMAT_VERSION (2) ///< Bump when the cleaning algorithm changes so old entries are not reused.
+
+/**
+ * @brief Keys of a table in the cache.
+ */
+typedef struct
+{
+    char dir[1024];                          ///< Cache directory.
+    u64  result_key;                         ///< Key of the complete output.
+    u64  qty_keys[number_of_eos_quantities]; ///< Key of each filtered quantity.
+} table_cache;
+
+/**
+ * @brief Hashes a table (in parallel) and the options.
+ *
+ * @param opts Pointer to the command line options.
+ * @param table Pointer to the stellar_collapse_eos structure as read from the input file.
+ * @param result_key Key of the complete output (depends on all data and the options).
+ * @param qty_keys Key of each filtered quantity (depends only on its data and the filter parameters).
+ */
+void compute_table_keys(const options_t *opts, const stellar_collapse_eos *table, u64 *result_key, u64 *qty_keys);
+
+/**
+ * @brief Hashes a table (in parallel) and the options to compute its cache keys, creating the directory if needed.
+ *
+ * Must be called before the table is cleaned.
+ *
+ * @param cache The cache keys to initialize.
+ * @param opts Pointer to the command line options (including the cache directory).
+ * @param table Pointer to the stellar_collapse_eos structure as read from the input file.
+ */
+void init_table_cache(table_cache *cache, const options_t *opts, const stellar_collapse_eos *table);
+
+/**
+ * @brief Copies the cached output of a run to the output path, if there is one.
+ *
+ * @return true on a hit.
+ */
+bool fetch_cached_result(const table_cache *cache, const options_t *opts);
+
+/**
+ * @brief Stores the output of a run in the cache.
+ */
+void store_cached_result(const table_cache *cache, const options_t *opts);
+
+/**
+ * @brief Returns the hooks that let clean_table_cached load and store filtered quantities.
+ */
+filter_cache make_filter_cache(table_cache *cache);
+
+#endif // CACHE_H
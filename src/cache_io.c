@@ -0,0 +1,274 @@
+// Needed for getpid(2) and mkdir(2)
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <hdf5.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "hash.h"
+#include "hdf5_helpers.h"
+#include "median_filter.h"
+#include "utils.h"
+
+static u64
+f64_bits(const f64 x)
+{
+    u64 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+static u64
+hash_words(const u64 *words, const int n)
+{
+    return xxh64(words, sizeof(u64) * n, CACHE_FORMAT_VERSION);
+}
+
+static u64
+hash_filter_parameters(void)
+{
+    const u64 words[3] = {CACHE_FORMAT_VERSION, MF_W, f64_bits(DELTASMOOTH)};
+    return hash_words(words, 3);
+}
+
+static u64
+hash_options(const options_t *opts)
+{
+    // Only the options that change the contents of the output
+    u64 words[24 + 6 * number_of_eos_quantities];
+    int n = 0;
+
+    words[n++] = opts->smoother;
+    words[n++] = opts->derivs;
+    words[n++] = opts->output_format;
+    words[n++] = opts->layout;
+    words[n++] = opts->layout_pad;
+    words[n++] = opts->layout_tile;
+    words[n++] = opts->n_layout_qtys;
+    for(int q = 0; q < opts->n_layout_qtys; q++) {
+        words[n++] = opts->layout_qtys[q];
+    }
+    words[n++] = opts->reduce_precision;
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        words[n++] = opts->precision[q].type;
+        words[n++] = opts->precision[q].relative;
+        words[n++] = f64_bits(opts->precision[q].bound);
+    }
+    words[n++] = f64_bits(opts->decimate_tolerance);
+    words[n++] = opts->n_decimate_qtys;
+    for(int q = 0; q < opts->n_decimate_qtys; q++) {
+        words[n++] = opts->decimate_qtys[q];
+    }
+    words[n++] = opts->use_roi;
+    for(int axis = 0; opts->use_roi && axis < 3; axis++) {
+        words[n++] = f64_bits(opts->roi_min[axis]);
+        words[n++] = f64_bits(opts->roi_max[axis]);
+    }
+    return hash_words(words, n);
+}
+
+void
+compute_table_keys(const options_t *opts, const stellar_collapse_eos *table, u64 *result_key, u64 *qty_keys)
+{
+    const u64         size        = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    const u64         filter_hash = hash_filter_parameters();
+    const index_box_t box         = select_filter_box(table, opts);
+
+    u64 words[8 + number_of_eos_quantities];
+    int n      = 0;
+    words[n++] = filter_hash;
+    words[n++] = hash_options(opts);
+    words[n++] = ((u64)table->n_rho << 42) ^ ((u64)table->n_temperature << 21) ^ (u64)table->n_ye;
+    words[n++] = f64_bits(table->energy_shift);
+    words[n++] = parallel_hash(table->log10_rho, sizeof(f64) * table->n_rho, 0);
+    words[n++] = parallel_hash(table->log10_temperature, sizeof(f64) * table->n_temperature, 0);
+    words[n++] = parallel_hash(table->ye, sizeof(f64) * table->n_ye, 0);
+
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        const u64 data_hash    = parallel_hash(table->data[q], sizeof(f64) * size, 0);
+        const u64 qty_words[10] = {
+            filter_hash, q, words[2], data_hash, box.lo[0], box.hi[0], box.lo[1], box.hi[1], box.lo[2], box.hi[2],
+        };
+        qty_keys[q] = hash_words(qty_words, 10);
+        words[n++]             = data_hash;
+    }
+    *result_key = hash_words(words, n);
+}
+
+void
+init_table_cache(table_cache *cache, const options_t *opts, const stellar_collapse_eos *table)
+{
+    snprintf(cache->dir, sizeof(cache->dir), "%s", opts->cache_dir);
+    if(mkdir(cache->dir, 0755) != 0 && errno != EEXIST) {
+        error(FILE_OPEN_FAILED, "Could not create cache directory '%s'\n", cache->dir);
+    }
+
+    compute_table_keys(opts, table, &cache->result_key, cache->qty_keys);
+    debug("Cache key of the result: %016" PRIx64 "\n", cache->result_key);
+}
+
+static void
+cache_entry_path(const table_cache *cache, const u64 key, const char *suffix, char *path, const usize size)
+{
+    snprintf(path, size, "%s/%016" PRIx64 "%s", cache->dir, key, suffix);
+}
+
+static bool
+copy_file(const char *src_path, const char *dst_path)
+{
+    FILE *src = fopen(src_path, "rb");
+    if(!src) {
+        return false;
+    }
+    FILE *dst = fopen(dst_path, "wb");
+    if(!dst) {
+        fclose(src);
+        return false;
+    }
+
+    static char buffer[1 << 20];
+    usize       n;
+    bool        ok = true;
+    while((n = fread(buffer, 1, sizeof(buffer), src)) > 0) {
+        if(fwrite(buffer, 1, n, dst) != n) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && !ferror(src);
+
+    fclose(src);
+    return fclose(dst) == 0 && ok;
+}
+
+static bool
+uses_result_cache(const options_t *opts)
+{
+    // Other output modes carry objects over from the input file, which are not part of the key
+    return opts->output_mode == OUTPUT_REWRITE && opts->patch_path[0] == '\0';
+}
+
+bool
+fetch_cached_result(const table_cache *cache, const options_t *opts)
+{
+    if(!uses_result_cache(opts)) {
+        return false;
+    }
+
+    // Copied rather than linked: a later run writing to the same output would otherwise truncate the entry
+    char path[1100];
+    cache_entry_path(cache, cache->result_key, ".h5", path, sizeof(path));
+    if(access(path, R_OK) != 0) {
+        return false;
+    }
+    if(!copy_file(path, opts->output_table_path)) {
+        warn("Could not copy cached result '%s'; cleaning the table again\n", path);
+        return false;
+    }
+    info("Copied cached result '%s' to '%s'\n", path, opts->output_table_path);
+    return true;
+}
+
+static void
+commit_entry(const char *tmp_path, const char *path)
+{
+    if(rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        warn("Could not store cache entry '%s'\n", path);
+    }
+}
+
+void
+store_cached_result(const table_cache *cache, const options_t *opts)
+{
+    if(!uses_result_cache(opts)) {
+        return;
+    }
+
+    char path[1100], tmp_path[1200];
+    cache_entry_path(cache, cache->result_key, ".h5", path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+    if(!copy_file(opts->output_table_path, tmp_path)) {
+        remove(tmp_path);
+        warn("Could not store cache entry '%s'\n", path);
+        return;
+    }
+    commit_entry(tmp_path, path);
+    debug("Stored cache entry '%s'\n", path);
+}
+
+static bool
+load_cached_quantity(void *ctx, stellar_collapse_eos *table, const stellar_collapse_eos_quantity qty, u64 *n_replaced)
+{
+    const table_cache *cache = (const table_cache *)ctx;
+
+    char path[1100];
+    cache_entry_path(cache, cache->qty_keys[qty], ".qty.h5", path, sizeof(path));
+    if(access(path, R_OK) != 0) {
+        return false;
+    }
+
+    hid_t file_id = H5Fopen(path, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(file_id < 0) {
+        return false;
+    }
+    const u64 size = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    if(get_hdf5_dataset_size(file_id, "data") != size) {
+        H5Fclose(file_id);
+        return false;
+    }
+
+    f64 *data = read_hdf5_dataset(file_id, F64, "data");
+    i32  begin, end;
+    read_hdf5_attribute(file_id, U64, "n_replaced", n_replaced);
+    read_hdf5_attribute(file_id, I32, "modified_ye_begin", &begin);
+    read_hdf5_attribute(file_id, I32, "modified_ye_end", &end);
+    H5Fclose(file_id);
+
+    free(table->data[qty]);
+    table->data[qty] = data;
+    mark_ye_planes_modified(table, qty, begin, end);
+    return true;
+}
+
+static void
+store_cached_quantity(
+    void                               *ctx,
+    const stellar_collapse_eos         *table,
+    const stellar_collapse_eos_quantity qty,
+    const u64                           n_replaced
+)
+{
+    const table_cache *cache = (const table_cache *)ctx;
+
+    char path[1100], tmp_path[1200];
+    cache_entry_path(cache, cache->qty_keys[qty], ".qty.h5", path, sizeof(path));
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%ld", path, (long)getpid());
+
+    hid_t file_id = H5Fcreate(tmp_path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if(file_id < 0) {
+        warn("Could not store cache entry '%s'\n", path);
+        return;
+    }
+    const hsize_t dims[3] = {table->n_ye, table->n_temperature, table->n_rho};
+    write_hdf5_dataset(file_id, F64, 3, dims, table->data[qty], "data");
+    write_hdf5_attribute(file_id, U64, "n_replaced", &n_replaced);
+    write_hdf5_attribute(file_id, I32, "modified_ye_begin", &table->modified_ye_begin[qty]);
+    write_hdf5_attribute(file_id, I32, "modified_ye_end", &table->modified_ye_end[qty]);
+    H5Fclose(file_id);
+
+    commit_entry(tmp_path, path);
+}
+
+filter_cache
+make_filter_cache(table_cache *cache)
+{
+    const filter_cache hooks = {load_cached_quantity, store_cached_quantity, cache};
+    return hooks;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file calibrate.h
+ * @author Leo Werneck
+ *
+ * @brief Calibrates execution profiles on the machine the cleaner runs on, and loads them on later runs.
+ *
+ * Profiles are stored as '<profile dir>/<machine key>.profile', where the machine key is a hash of the CPU model and
+ * of the number of online processors, so that a profile directory can be shared by the nodes of a cluster. The key
+ * does not depend on the CPU affinity of the process, so every allocation on a node finds the same profile. The file
+ * holds one 'key = value' line for each field of the execution_profile.
+ */
+#ifndef CALIBRATE_H
+#define CALIBRATE_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "options.h"
+
+#define PROFILE_DIR_DEFAULT     ".config/eos_cleaner" ///< Default profile directory, relative to $HOME.
+#define CALIBRATE_SLAB_PLANES   (16)                  ///< Ye planes of the slab the trials run on.
+#define CALIBRATE_REPEATS       (3)                   ///< Runs of each trial; the fastest one is kept.
+#define CALIBRATE_MAX_CHOICES   (16)                  ///< Maximum number of thread counts tried.
+#define CALIBRATE_MAX_LINE_SIZE (256)                 ///< Longest line read from /proc/cpuinfo and profiles.
+
+/**
+ * @brief Returns the key of the machine the cleaner runs on (hash of the CPU model and of the online processors).
+ */
+u64 get_machine_key(void);
+
+/**
+ * @brief Loads the execution profile of this machine, if one was calibrated.
+ *
+ * Thread counts are ignored when OMP_NUM_THREADS is set, so that the environment still takes precedence, and when they
+ * exceed the threads available to the process (e.g., in a smaller allocation on the same node). A missing profile
+ * leaves the defaults; an invalid one is reported and ignored.
+ *
+ * @param opts Pointer to the options (profile directory).
+ *
+ * @return True if a profile was loaded.
+ */
+bool load_execution_profile(const options_t *opts);
+
+/**
+ * @brief Times the execution choices of the parallel kernels and stores the fastest ones in this machine's profile.
+ *
+ * The trials run on a slab of CALIBRATE_SLAB_PLANES Ye planes from the middle of the input table, which is restored
+ * before every run. The median filter is applied to the quantities selected by the smoothing options, with every
+ * combination of thread count (halving down to one) and tile edge; the cs2 recomputation is timed with every
+ * combination of thread count, schedule, and number of collapsed loops. Nothing is written besides the profile.
+ *
+ * @param opts Pointer to the options (input table, smoothing options, and profile directory).
+ */
+void calibrate_execution_profile(const options_t *opts);
+
+#endif // CALIBRATE_H
@@ -0,0 +1,391 @@
+// Needed for mkdir(2) and sysconf(3)
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include "calibrate.h"
+#include "cleaner.h"
+#include "execution_profile.h"
+#include "hash.h"
+#include "utils.h"
+
+/**
+ * @brief Quantities filtered by the median filter trials.
+ */
+typedef struct
+{
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+    int                           n_qtys;
+    bool                          single_precision;
+} filter_trial;
+
+typedef void (*trial_kernel)(stellar_collapse_eos *slab, const void *ctx);
+
+static f64
+wall_time(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (f64)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// Processors of the machine, not the ones the process is bound to (cpusets, taskset, or Slurm allocations)
+static int
+get_num_procs(void)
+{
+    const long n_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    return n_procs > 0 ? (int)n_procs : 1;
+}
+
+static void
+get_cpu_model(char *model, const usize size)
+{
+    snprintf(model, size, "unknown");
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if(!fp) {
+        return;
+    }
+    char line[CALIBRATE_MAX_LINE_SIZE];
+    while(fgets(line, sizeof(line), fp)) {
+        const char *colon = strchr(line, ':');
+        if(colon && strncmp(line, "model name", 10) == 0) {
+            snprintf(model, size, "%s", colon + 1 + (colon[1] == ' '));
+            model[strcspn(model, "\n")] = '\0';
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+u64
+get_machine_key(void)
+{
+    char model[CALIBRATE_MAX_LINE_SIZE];
+    get_cpu_model(model, sizeof(model));
+    return xxh64(model, strlen(model), (u64)get_num_procs());
+}
+
+static bool
+get_profile_dir(const options_t *opts, char *dir, const usize size)
+{
+    if(opts->profile_dir[0] != '\0') {
+        snprintf(dir, size, "%s", opts->profile_dir);
+        return true;
+    }
+    const char *home = getenv("HOME");
+    if(!home || home[0] == '\0') {
+        return false;
+    }
+    snprintf(dir, size, "%s/%s", home, PROFILE_DIR_DEFAULT);
+    return true;
+}
+
+static void
+get_profile_path(const char *dir, char *path, const usize size)
+{
+    snprintf(path, size, "%s/%016" PRIx64 ".profile", dir, get_machine_key());
+}
+
+static void
+create_profile_dir(const char *dir)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s", dir);
+
+    // Parents first, e.g., $HOME/.config before $HOME/.config/eos_cleaner
+    for(char *p = path + 1;; p++) {
+        if(*p != '/' && *p != '\0') {
+            continue;
+        }
+        const char c = *p;
+        *p           = '\0';
+        if(mkdir(path, 0755) != 0 && errno != EEXIST) {
+            error(FILE_OPEN_FAILED, "Could not create profile directory '%s'\n", path);
+        }
+        *p = c;
+        if(c == '\0') {
+            break;
+        }
+    }
+}
+
+static bool
+parse_execution_profile(FILE *fp, execution_profile *profile)
+{
+    *profile = default_execution_profile();
+
+    char line[CALIBRATE_MAX_LINE_SIZE];
+    while(fgets(line, sizeof(line), fp)) {
+        char key[64], value[64];
+        if(line[0] == '#' || sscanf(line, " %63[^= ] = %63s", key, value) != 2) {
+            continue;
+        }
+        if(!strcmp(key, "filter_threads")) {
+            profile->filter_threads = atoi(value);
+        }
+        else if(!strcmp(key, "filter_tile")) {
+            profile->filter_tile = atoi(value);
+        }
+        else if(!strcmp(key, "cs2_threads")) {
+            profile->cs2_threads = atoi(value);
+        }
+        else if(!strcmp(key, "cs2_schedule")) {
+            profile->cs2_schedule = schedule_from_str(value);
+        }
+        else if(!strcmp(key, "cs2_collapse")) {
+            profile->cs2_collapse = atoi(value);
+        }
+        else {
+            return false;
+        }
+    }
+    return profile->filter_threads >= 0 && profile->filter_tile > 0 && profile->cs2_threads >= 0
+        && profile->cs2_schedule != SCHEDULE_INVALID && (profile->cs2_collapse == 2 || profile->cs2_collapse == 3);
+}
+
+static void
+write_execution_profile(const execution_profile *profile, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if(!fp) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", path);
+    }
+
+    char model[CALIBRATE_MAX_LINE_SIZE];
+    get_cpu_model(model, sizeof(model));
+    fprintf(fp, "# Execution profile written by --calibrate\n");
+    fprintf(fp, "# CPU: %s (%d processors)\n", model, get_num_procs());
+    fprintf(fp, "filter_threads = %d\n", profile->filter_threads);
+    fprintf(fp, "filter_tile = %d\n", profile->filter_tile);
+    fprintf(fp, "cs2_threads = %d\n", profile->cs2_threads);
+    fprintf(fp, "cs2_schedule = %s\n", schedule_to_str(profile->cs2_schedule));
+    fprintf(fp, "cs2_collapse = %d\n", profile->cs2_collapse);
+    if(fclose(fp) != 0) {
+        error(FILE_IO_FAILED, "Could not write execution profile '%s'\n", path);
+    }
+}
+
+bool
+load_execution_profile(const options_t *opts)
+{
+    char dir[1024], path[1100];
+    if(!get_profile_dir(opts, dir, sizeof(dir))) {
+        return false;
+    }
+    get_profile_path(dir, path, sizeof(path));
+
+    FILE *fp = fopen(path, "r");
+    if(!fp) {
+        debug("No execution profile found at '%s'; using the defaults\n", path);
+        return false;
+    }
+    execution_profile profile;
+    const bool        valid = parse_execution_profile(fp, &profile);
+    fclose(fp);
+    if(!valid) {
+        warn("Ignoring invalid execution profile '%s'\n", path);
+        return false;
+    }
+
+    // The environment takes precedence over the calibrated thread counts, which cannot exceed the allocation
+    if(getenv("OMP_NUM_THREADS")) {
+        profile.filter_threads = 0;
+        profile.cs2_threads    = 0;
+    }
+#ifdef _OPENMP
+    if(profile.filter_threads > omp_get_max_threads()) {
+        profile.filter_threads = 0;
+    }
+    if(profile.cs2_threads > omp_get_max_threads()) {
+        profile.cs2_threads = 0;
+    }
+#endif
+    set_execution_profile(&profile);
+    info("Execution profile : %s\n", path);
+
+    return true;
+}
+
+static void
+restore_slab(stellar_collapse_eos *slab, const stellar_collapse_eos *table, const i32 iy_begin)
+{
+    const u64 size   = (u64)slab->n_rho * slab->n_temperature * slab->n_ye;
+    const u64 offset = (u64)table->n_rho * table->n_temperature * iy_begin;
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        memcpy(slab->data[q], table->data[q] + offset, sizeof(f64) * size);
+    }
+}
+
+static void
+run_filter_trial(stellar_collapse_eos *slab, const void *ctx)
+{
+    const filter_trial *trial = ctx;
+    const index_box_t   box   = {
+        {0,           0,                   0         },
+        {slab->n_rho, slab->n_temperature, slab->n_ye},
+    };
+    apply_median_filter_to_quantities(
+        slab,
+        trial->qtys,
+        trial->n_qtys,
+        &box,
+        trial->single_precision,
+        NULL,
+        NULL,
+        NULL
+    );
+}
+
+static void
+run_cs2_trial(stellar_collapse_eos *slab, const void *ctx)
+{
+    (void)ctx;
+    recompute_cs2_and_check_physical_limits(slab);
+}
+
+static f64
+time_trial(
+    stellar_collapse_eos       *slab,
+    const stellar_collapse_eos *table,
+    const i32                   iy_begin,
+    const execution_profile    *profile,
+    trial_kernel                kernel,
+    const void                 *ctx
+)
+{
+    set_execution_profile(profile);
+
+    // Best of a few runs on the original data; the kernels' own messages are muted
+    f64 best = INFINITY;
+    for(int r = 0; r < CALIBRATE_REPEATS; r++) {
+        restore_slab(slab, table, iy_begin);
+        const log_level_t level = set_log_level(LOG_ERROR);
+        const f64         start = wall_time();
+        kernel(slab, ctx);
+        const f64 elapsed = wall_time() - start;
+        set_log_level(level);
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+static int
+get_thread_choices(int *choices)
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    int n_choices = 0;
+    for(int t = n_threads; t >= 1 && n_choices < CALIBRATE_MAX_CHOICES; t /= 2) {
+        choices[n_choices++] = t;
+    }
+    return n_choices;
+}
+
+void
+calibrate_execution_profile(const options_t *opts)
+{
+    char dir[1024], path[1100];
+    if(!get_profile_dir(opts, dir, sizeof(dir))) {
+        error(UNKNOWN_OPTION, "HOME is not set; use '--profile-dir' to choose where to store the profile\n");
+    }
+    create_profile_dir(dir);
+    get_profile_path(dir, path, sizeof(path));
+
+    stellar_collapse_eos *table = read_stellar_collapse_eos_table(opts->input_table_path);
+    info("Successfully read table from file '%s'\n", opts->input_table_path);
+
+    // The slab shares the axes with the table, but has its own copy of the data
+    stellar_collapse_eos slab = *table;
+    slab.n_ye                 = table->n_ye < CALIBRATE_SLAB_PLANES ? table->n_ye : CALIBRATE_SLAB_PLANES;
+    const i32 iy_begin        = (table->n_ye - slab.n_ye) / 2;
+    const u64 size            = (u64)slab.n_rho * slab.n_temperature * slab.n_ye;
+    slab.ye                   = table->ye + iy_begin;
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        slab.data[q] = malloc_or_error(sizeof(f64) * size);
+    }
+
+    filter_trial filter;
+    filter.n_qtys           = select_quantities_to_filter(opts, filter.qtys);
+    filter.single_precision = opts->median_single_precision;
+
+    int       threads[CALIBRATE_MAX_CHOICES];
+    const int n_threads = get_thread_choices(threads);
+    const int tiles[]   = {2, 4, 8};
+    info("Calibrating on %d Ye planes (%d x %d x %d points)\n", slab.n_ye, slab.n_rho, slab.n_temperature, slab.n_ye);
+
+    execution_profile best      = default_execution_profile();
+    f64               best_time = INFINITY;
+    for(int t = 0; t < n_threads && filter.n_qtys > 0; t++) {
+        for(int k = 0; k < (int)(sizeof(tiles) / sizeof(tiles[0])); k++) {
+            execution_profile trial = best;
+            trial.filter_threads    = threads[t];
+            trial.filter_tile       = tiles[k];
+
+            const f64 elapsed = time_trial(&slab, table, iy_begin, &trial, run_filter_trial, &filter);
+            info("  median filter: %3d threads, tile %d: %.4f s\n", threads[t], tiles[k], elapsed);
+            if(elapsed < best_time) {
+                best.filter_threads = threads[t];
+                best.filter_tile    = tiles[k];
+                best_time           = elapsed;
+            }
+        }
+    }
+
+    best_time = INFINITY;
+    for(int t = 0; t < n_threads; t++) {
+        for(schedule_t schedule = SCHEDULE_STATIC; schedule <= SCHEDULE_GUIDED; schedule++) {
+            for(int collapse = 2; collapse <= 3; collapse++) {
+                execution_profile trial = best;
+                trial.cs2_threads       = threads[t];
+                trial.cs2_schedule      = schedule;
+                trial.cs2_collapse      = collapse;
+
+                const f64 elapsed = time_trial(&slab, table, iy_begin, &trial, run_cs2_trial, NULL);
+                info(
+                    "  cs2           : %3d threads, %-7s schedule, collapse %d: %.4f s\n",
+                    threads[t],
+                    schedule_to_str(schedule),
+                    collapse,
+                    elapsed
+                );
+                if(elapsed < best_time) {
+                    best.cs2_threads  = threads[t];
+                    best.cs2_schedule = schedule;
+                    best.cs2_collapse = collapse;
+                    best_time         = elapsed;
+                }
+            }
+        }
+    }
+
+    info("Median filter     : %d threads, tile %d\n", best.filter_threads, best.filter_tile);
+    info(
+        "cs2 recomputation : %d threads, %s schedule, collapse %d\n",
+        best.cs2_threads,
+        schedule_to_str(best.cs2_schedule),
+        best.cs2_collapse
+    );
+    write_execution_profile(&best, path);
+    info("Execution profile written to '%s'\n", path);
+
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        free(slab.data[q]);
+    }
+    free_stellar_collapse_eos_table(table);
+}
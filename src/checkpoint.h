@@ -0,0 +1,54 @@
+/**
+ * @file checkpoint.h
+ * @author Leo Werneck
+ *
+ * @brief Checkpointing of filtered quantities so that interrupted runs can be resumed.
+ *
+ * Each quantity is written to a scratch HDF5 file as soon as the median filter finishes it, together with a key
+ * derived from its input data and the filter parameters. The "manifest" attribute of the file lists the quantities
+ * that are complete; it is only updated after the quantity's dataset has been written and the file closed, so a run
+ * interrupted mid-write never lists a partial quantity. The checkpoint is removed once the output is written.
+ */
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "cleaner.h"
+#include "options.h"
+#include "stellar_collapse_eos.h"
+
+/**
+ * @brief State of the checkpoint of a table.
+ */
+typedef struct
+{
+    char path[1024];                         ///< Path to the checkpoint file.
+    u64  qty_keys[number_of_eos_quantities]; ///< Key of each filtered quantity.
+    bool done[number_of_eos_quantities];     ///< Quantities listed in the manifest with a matching key.
+} table_checkpoint;
+
+/**
+ * @brief Opens the checkpoint of a table.
+ *
+ * With '--resume', an existing checkpoint is reused and its manifest read; otherwise (or if it cannot be read) a new,
+ * empty checkpoint is created.
+ *
+ * @param checkpoint The checkpoint state to initialize.
+ * @param opts Pointer to the command line options (checkpoint path and resume flag).
+ * @param table Pointer to the stellar_collapse_eos structure as read from the input file.
+ */
+void open_table_checkpoint(table_checkpoint *checkpoint, const options_t *opts, const stellar_collapse_eos *table);
+
+/**
+ * @brief Returns the hooks that let clean_table_cached resume from and write to the checkpoint.
+ */
+filter_cache make_checkpoint_hooks(table_checkpoint *checkpoint);
+
+/**
+ * @brief Removes the checkpoint file once it is no longer needed.
+ */
+void remove_table_checkpoint(const table_checkpoint *checkpoint);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,179 @@
+// Needed for access(2)
+#define _POSIX_C_SOURCE 200809L
+
+#include <hdf5.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "checkpoint.h"
+#include "hdf5_helpers.h"
+#include "interleaved_layout.h"
+#include "utils.h"
+
+#define MANIFEST "manifest"
+
+static void
+write_manifest(hid_t file_id, const bool *done)
+{
+    char manifest[1024] = "";
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        if(done[q]) {
+            strcat(manifest, manifest[0] != '\0' ? "," : "");
+            strcat(manifest, stellar_collapse_qty_to_str(q));
+        }
+    }
+    if(H5Aexists(file_id, MANIFEST) > 0) {
+        H5Adelete(file_id, MANIFEST);
+    }
+    write_hdf5_string_attribute(file_id, MANIFEST, manifest);
+}
+
+static bool
+read_manifest(table_checkpoint *checkpoint)
+{
+    hid_t file_id = H5Fopen(checkpoint->path, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(file_id < 0) {
+        return false;
+    }
+
+    char manifest[1024];
+    if(!read_hdf5_string_attribute(file_id, MANIFEST, manifest, sizeof(manifest))) {
+        H5Fclose(file_id);
+        return false;
+    }
+
+    // Quantities filtered from different input data (or with other filter parameters) are filtered again
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+    const int                     n_qtys = parse_quantity_list(manifest, qtys);
+    for(int n = 0; n < n_qtys; n++) {
+        hid_t dataset_id = H5Dopen(file_id, stellar_collapse_qty_to_str(qtys[n]), H5P_DEFAULT);
+        u64   key        = 0;
+        if(dataset_id >= 0) {
+            read_hdf5_attribute(dataset_id, U64, "key", &key);
+            H5Dclose(dataset_id);
+        }
+        checkpoint->done[qtys[n]] = key == checkpoint->qty_keys[qtys[n]];
+    }
+
+    H5Fclose(file_id);
+    return true;
+}
+
+void
+open_table_checkpoint(table_checkpoint *checkpoint, const options_t *opts, const stellar_collapse_eos *table)
+{
+    u64 result_key;
+    snprintf(checkpoint->path, sizeof(checkpoint->path), "%s", opts->checkpoint_path);
+    compute_table_keys(opts, table, &result_key, checkpoint->qty_keys);
+    memset(checkpoint->done, 0, sizeof(checkpoint->done));
+
+    if(opts->resume && access(checkpoint->path, R_OK) == 0) {
+        if(read_manifest(checkpoint)) {
+            int n_done = 0;
+            for(int q = 0; q < number_of_eos_quantities; q++) {
+                n_done += checkpoint->done[q];
+            }
+            info("Resuming from checkpoint '%s' (%d quantities done)\n", checkpoint->path, n_done);
+            return;
+        }
+        warn("Could not read checkpoint '%s'; starting over\n", checkpoint->path);
+    }
+
+    hid_t file_id = H5Fcreate(checkpoint->path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not create checkpoint '%s'\n", checkpoint->path);
+    }
+    write_manifest(file_id, checkpoint->done);
+    H5Fclose(file_id);
+}
+
+static bool
+load_checkpointed_quantity(
+    void                               *ctx,
+    stellar_collapse_eos               *table,
+    const stellar_collapse_eos_quantity qty,
+    u64                                *n_replaced
+)
+{
+    const table_checkpoint *checkpoint = (const table_checkpoint *)ctx;
+    if(!checkpoint->done[qty]) {
+        return false;
+    }
+
+    hid_t file_id = H5Fopen(checkpoint->path, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open checkpoint '%s'\n", checkpoint->path);
+    }
+
+    const char *name       = stellar_collapse_qty_to_str(qty);
+    f64        *data       = read_hdf5_dataset(file_id, F64, name);
+    hid_t       dataset_id = H5Dopen(file_id, name, H5P_DEFAULT);
+    i32         begin, end;
+    read_hdf5_attribute(dataset_id, U64, "n_replaced", n_replaced);
+    read_hdf5_attribute(dataset_id, I32, "modified_ye_begin", &begin);
+    read_hdf5_attribute(dataset_id, I32, "modified_ye_end", &end);
+    H5Dclose(dataset_id);
+    H5Fclose(file_id);
+
+    free(table->data[qty]);
+    table->data[qty] = data;
+    mark_ye_planes_modified(table, qty, begin, end);
+    return true;
+}
+
+static void
+checkpoint_quantity(
+    void                               *ctx,
+    const stellar_collapse_eos         *table,
+    const stellar_collapse_eos_quantity qty,
+    const u64                           n_replaced
+)
+{
+    table_checkpoint *checkpoint = (table_checkpoint *)ctx;
+
+    hid_t file_id = H5Fopen(checkpoint->path, H5F_ACC_RDWR, H5P_DEFAULT);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open checkpoint '%s'\n", checkpoint->path);
+    }
+
+    // A stale dataset from an earlier run (with different input data) is replaced
+    const char *name = stellar_collapse_qty_to_str(qty);
+    if(H5Lexists(file_id, name, H5P_DEFAULT) > 0) {
+        H5Ldelete(file_id, name, H5P_DEFAULT);
+    }
+
+    const hsize_t dims[3] = {table->n_ye, table->n_temperature, table->n_rho};
+    write_hdf5_dataset(file_id, F64, 3, dims, table->data[qty], name);
+    hid_t dataset_id = H5Dopen(file_id, name, H5P_DEFAULT);
+    write_hdf5_attribute(dataset_id, U64, "key", &checkpoint->qty_keys[qty]);
+    write_hdf5_attribute(dataset_id, U64, "n_replaced", &n_replaced);
+    write_hdf5_attribute(dataset_id, I32, "modified_ye_begin", &table->modified_ye_begin[qty]);
+    write_hdf5_attribute(dataset_id, I32, "modified_ye_end", &table->modified_ye_end[qty]);
+    H5Dclose(dataset_id);
+
+    // The quantity is only listed in the manifest once its data is on disk
+    H5Fflush(file_id, H5F_SCOPE_GLOBAL);
+    checkpoint->done[qty] = true;
+    write_manifest(file_id, checkpoint->done);
+    H5Fclose(file_id);
+
+    debug("Checkpointed quantity '%s'\n", name);
+}
+
+filter_cache
+make_checkpoint_hooks(table_checkpoint *checkpoint)
+{
+    const filter_cache hooks = {load_checkpointed_quantity, checkpoint_quantity, checkpoint};
+    return hooks;
+}
+
+void
+remove_table_checkpoint(const table_checkpoint *checkpoint)
+{
+    if(remove(checkpoint->path) != 0) {
+        warn("Could not remove checkpoint '%s'\n", checkpoint->path);
+    }
+}
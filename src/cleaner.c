@@ -0,0 +1,175 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "cleaner.h"
+#include "decimate.h"
+#include "median_filter.h"
+#include "utils.h"
+
+static bool
+is_derivative(const stellar_collapse_eos_quantity qty)
+{
+    return qty == eos_dpdrhoe || qty == eos_dpderho || qty == eos_dedt;
+}
+
+int
+select_quantities_to_filter(const options_t *opts, stellar_collapse_eos_quantity *qtys)
+{
+    int n_qtys = 0;
+    if(opts->smoother == SMOOTH_ALL) {
+        info("Applying median filter to *all* table quantities:\n");
+        for(int qty = 0; qty < number_of_eos_quantities; qty++) {
+            if(opts->derivs != DERIVS_SMOOTH && is_derivative(qty)) {
+                continue;
+            }
+            qtys[n_qtys++] = qty;
+        }
+    }
+    else if(opts->smoother == SMOOTH_HYDRO_ONLY) {
+        info("Applying median filter to hydro quantities only (not derivatives)\n");
+        for(int qty = 0; qty < number_of_eos_quantities; qty++) {
+            if(is_derivative(qty)) {
+                continue;
+            }
+            qtys[n_qtys++] = qty;
+        }
+    }
+    else if(opts->smoother == SMOOTH_DERIVS_ONLY) {
+        info("Applying median filter to derivatives only\n");
+        qtys[n_qtys++] = eos_dpdrhoe;
+        qtys[n_qtys++] = eos_dpderho;
+        qtys[n_qtys++] = eos_dedt;
+    }
+    return n_qtys;
+}
+
+static void
+select_axis_range(const f64 *axis, const i32 n, const f64 min, const f64 max, u64 *lo, u64 *hi)
+{
+    i32 i = 0, j = n;
+    while(i < n && axis[i] < min) {
+        i++;
+    }
+    while(j > i && axis[j - 1] > max) {
+        j--;
+    }
+    *lo = i;
+    *hi = j;
+}
+
+index_box_t
+select_filter_box(const stellar_collapse_eos *table, const options_t *opts)
+{
+    index_box_t box = {
+        {0,            0,                    0          },
+        {table->n_rho, table->n_temperature, table->n_ye},
+    };
+    if(!opts->use_roi) {
+        return box;
+    }
+
+    const f64 *axes[3] = {table->log10_rho, table->log10_temperature, table->ye};
+    const i32  n[3]    = {table->n_rho, table->n_temperature, table->n_ye};
+    for(int axis = 0; axis < 3; axis++) {
+        // Density and temperature are given in physical units, but tabulated logarithmically
+        const f64 min = axis < 2 ? log10(opts->roi_min[axis]) : opts->roi_min[axis];
+        const f64 max = axis < 2 ? log10(opts->roi_max[axis]) : opts->roi_max[axis];
+        select_axis_range(axes[axis], n[axis], min, max, &box.lo[axis], &box.hi[axis]);
+    }
+    return box;
+}
+
+u64
+clean_table(stellar_collapse_eos *table, const options_t *opts)
+{
+    return clean_table_cached(table, opts, NULL);
+}
+
+u64
+clean_table_cached(stellar_collapse_eos *table, const options_t *opts, const filter_cache *cache)
+{
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+
+    u64       n_replaced[number_of_eos_quantities];
+    const int n_qtys = select_quantities_to_filter(opts, qtys);
+
+    // Quantities found in the cache are not filtered again
+    stellar_collapse_eos_quantity to_filter[number_of_eos_quantities];
+    u64                           n_filtered[number_of_eos_quantities];
+    bool                          cached[number_of_eos_quantities] = {false};
+    int                           n_to_filter                      = 0;
+    for(int n = 0; n < n_qtys; n++) {
+        cached[n] = cache && cache->load(cache->ctx, table, qtys[n], &n_replaced[n]);
+        if(!cached[n]) {
+            to_filter[n_to_filter++] = qtys[n];
+        }
+    }
+
+    // Only the region of interest (and the halo read by the filter window) is touched
+    const index_box_t box = select_filter_box(table, opts);
+    if(opts->use_roi) {
+        info(
+            "Region of interest: points [%" PRIu64 ", %" PRIu64 ") x [%" PRIu64 ", %" PRIu64 ") x [%" PRIu64
+            ", %" PRIu64 ") in (rho, T, Ye)\n",
+            box.lo[0],
+            box.hi[0],
+            box.lo[1],
+            box.hi[1],
+            box.lo[2],
+            box.hi[2]
+        );
+        if(box.lo[0] == box.hi[0] || box.lo[1] == box.hi[1] || box.lo[2] == box.hi[2]) {
+            warn("The region of interest contains no table points\n");
+        }
+    }
+    apply_median_filter_to_quantities(
+        table,
+        to_filter,
+        n_to_filter,
+        &box,
+        opts->median_single_precision,
+        n_filtered,
+        cache ? cache->store : NULL,
+        cache ? cache->ctx : NULL
+    );
+    for(int n = 0, m = 0; n < n_qtys; n++) {
+        if(!cached[n]) {
+            n_replaced[n] = n_filtered[m++];
+        }
+        info(
+            "  %-9s: %" PRIu64 " points replaced%s\n",
+            stellar_collapse_qty_to_str(qtys[n]),
+            n_replaced[n],
+            cached[n] ? " (cached)" : ""
+        );
+    }
+    flush_log();
+
+    // if(opts->derivs == DERIVS_RECOMPUTE) {
+    //     recompute_derivs(table);
+    // }
+
+    info("Recomputing cs2\n");
+    recompute_cs2_and_check_physical_limits_in_box(table, &box);
+    flush_log();
+
+    info("Validating table\n");
+    const u64 n_problems = validate_table(table);
+    flush_log();
+
+    if(opts->decimate_tolerance > 0) {
+        info("Decimating grid\n");
+        const u64 n_exceeding =
+            decimate_table(table, opts->decimate_qtys, opts->n_decimate_qtys, opts->decimate_tolerance);
+        flush_log();
+        if(n_exceeding) {
+            error(
+                INVALID_TABLE,
+                "Decimated table exceeds the tolerance at %" PRIu64 " points; try a smaller tolerance\n",
+                n_exceeding
+            );
+        }
+    }
+    return n_problems;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file cleaner.h
+ * @author Leo Werneck
+ *
+ * @brief Defines the cleaning pipeline applied to a single EOS table and the batch driver.
+ */
+#ifndef CLEANER_H
+#define CLEANER_H
+
+#include "median_filter.h"
+#include "options.h"
+#include "stellar_collapse_eos.h"
+
+/**
+ * @brief Selects the quantities the median filter is applied to.
+ *
+ * @param opts Pointer to the command line options.
+ * @param qtys Output array with room for number_of_eos_quantities entries.
+ *
+ * @return The number of selected quantities.
+ */
+int select_quantities_to_filter(const options_t *opts, stellar_collapse_eos_quantity *qtys);
+
+/**
+ * @brief Returns the box of table points the cleaner works on.
+ *
+ * This is the whole table, unless a region of interest was given ('--rho-range', '--temp-range', '--ye-range'), in
+ * which case it holds the grid points whose density, temperature, and Ye are inside the given ranges.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure.
+ * @param opts Pointer to the command line options.
+ */
+index_box_t select_filter_box(const stellar_collapse_eos *table, const options_t *opts);
+
+/**
+ * @brief Hooks that let the cleaner reuse median filtered quantities from a cache.
+ *
+ * The median filter processes each quantity independently, so a quantity whose input data did not change can be
+ * loaded instead of filtered.
+ */
+typedef struct
+{
+    /**
+     * @brief Replaces a quantity by its filtered version, if cached. Returns true on a hit.
+     */
+    bool (*load)(void *ctx, stellar_collapse_eos *table, stellar_collapse_eos_quantity qty, u64 *n_replaced);
+
+    /**
+     * @brief Stores a filtered quantity, as soon as the median filter finishes it.
+     */
+    filtered_quantity_callback store;
+
+    void *ctx; ///< Passed to the hooks.
+} filter_cache;
+
+/**
+ * @brief Cleans an EOS table in memory.
+ *
+ * Applies the median filter to the quantities selected by the smoothing and derivative options, recomputes cs2, and
+ * validates the result. If requested, the grid is then decimated.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to clean.
+ * @param opts Pointer to the command line options.
+ *
+ * @return The number of problems found by validate_table.
+ */
+u64 clean_table(stellar_collapse_eos *table, const options_t *opts);
+
+/**
+ * @brief Cleans an EOS table in memory, reusing filtered quantities from a cache.
+ *
+ * Same as clean_table, but each selected quantity is first looked up in the cache, and each quantity that had to be
+ * filtered is stored in it as soon as it is done.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to clean.
+ * @param opts Pointer to the command line options.
+ * @param cache The cache hooks, or NULL to filter every quantity.
+ *
+ * @return The number of problems found by validate_table.
+ */
+u64 clean_table_cached(stellar_collapse_eos *table, const options_t *opts, const filter_cache *cache);
+
+/**
+ * @brief Reads, cleans, and writes a single EOS table.
+ *
+ * @param opts Pointer to the command line options.
+ */
+void clean_table_file(const options_t *opts);
+
+/**
+ * @brief Cleans all input tables in a single process.
+ *
+ * Tables are processed in a three stage pipeline: while one table is being cleaned, the previous one is written to
+ * disk and the next one is read from disk. All HDF5 calls are issued from the same thread and at most three tables are
+ * resident in memory at any time (one when I/O overlap is disabled).
+ *
+ * @param opts Pointer to the command line options.
+ */
+void clean_table_batch(const options_t *opts);
+
+#endif // CLEANER_H
@@ -0,0 +1,237 @@
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include <stdio.h>
+
+#include "binary_table.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "cleaner.h"
+#include "consistency.h"
+#include "interleaved_layout.h"
+#include "patch.h"
+#include "utils.h"
+
+static void
+write_clean_table(
+    const stellar_collapse_eos *table,
+    const options_t            *opts,
+    const char                 *input_path,
+    const char                 *output_path
+)
+{
+    switch(opts->output_mode) {
+        case OUTPUT_COPY_THROUGH:
+            write_stellar_collapse_eos_table_copy_through(table, input_path, output_path);
+            info("Successfully wrote clean table to file '%s' (unmodified datasets copied)\n", output_path);
+            break;
+        case OUTPUT_IN_PLACE:
+            update_stellar_collapse_eos_table_in_place(table, input_path);
+            info("Successfully updated modified datasets in file '%s'\n", input_path);
+            break;
+        default:
+            if(opts->layout == LAYOUT_INTERLEAVED) {
+                const interleaved_layout layout = make_interleaved_layout(
+                    table,
+                    opts->layout_qtys,
+                    opts->n_layout_qtys,
+                    opts->layout_pad,
+                    opts->layout_tile
+                );
+                write_stellar_collapse_eos_table_interleaved(table, &layout, output_path);
+            }
+            else if(opts->output_format == FORMAT_BINARY) {
+                write_binary_table(table, output_path);
+            }
+            else if(opts->reduce_precision) {
+                write_stellar_collapse_eos_table_reduced(table, opts->precision, output_path);
+            }
+            else {
+                write_stellar_collapse_eos_table(table, output_path);
+            }
+            info("Successfully wrote clean table to file '%s'\n", output_path);
+            break;
+    }
+}
+
+// Chains the checkpoint and the cache: quantities are loaded from the first that has them and stored to both
+static bool
+load_from_hook_pair(void *ctx, stellar_collapse_eos *table, const stellar_collapse_eos_quantity qty, u64 *n_replaced)
+{
+    const filter_cache *hooks = (const filter_cache *)ctx;
+    return hooks[0].load(hooks[0].ctx, table, qty, n_replaced) || hooks[1].load(hooks[1].ctx, table, qty, n_replaced);
+}
+
+static void
+store_to_hook_pair(
+    void                               *ctx,
+    const stellar_collapse_eos         *table,
+    const stellar_collapse_eos_quantity qty,
+    const u64                           n_replaced
+)
+{
+    const filter_cache *hooks = (const filter_cache *)ctx;
+    hooks[0].store(hooks[0].ctx, table, qty, n_replaced);
+    hooks[1].store(hooks[1].ctx, table, qty, n_replaced);
+}
+
+static void
+check_consistency(const stellar_collapse_eos *table, const options_t *opts)
+{
+    const bool  write_mask = opts->consistency_mask_path[0] != '\0';
+    const usize size       = (usize)table->n_rho * table->n_temperature * table->n_ye;
+    u8         *mask       = write_mask ? malloc_or_error(sizeof(u8) * size) : NULL;
+
+    info("Checking thermodynamic consistency\n");
+    const consistency_report report = check_table_consistency(table, mask);
+    print_consistency_report(&report);
+    if(write_mask) {
+        write_consistency_mask(table, mask, opts->consistency_mask_path);
+        info("Successfully wrote consistency mask to file '%s'\n", opts->consistency_mask_path);
+        free(mask);
+    }
+    flush_log();
+}
+
+static void
+set_batch_output_path(const options_t *opts, const char *input_path, char *output_path)
+{
+    if(opts->output_mode == OUTPUT_IN_PLACE) {
+        snprintf(output_path, 1034, "%s", input_path);
+    }
+    else {
+        set_default_output_path(opts, input_path, output_path, 1034);
+    }
+}
+
+void
+clean_table_file(const options_t *opts)
+{
+    stellar_collapse_eos *table = read_stellar_collapse_eos_table(opts->input_table_path);
+    info("Successfully read table from file '%s'\n", opts->input_table_path);
+    flush_log();
+
+    table_cache      cache;
+    table_checkpoint checkpoint;
+    filter_cache     hooks[2];
+    int              n_hooks        = 0;
+    const bool       use_cache      = opts->cache_dir[0] != '\0';
+    const bool       use_checkpoint = opts->checkpoint_path[0] != '\0';
+    if(use_cache) {
+        init_table_cache(&cache, opts, table);
+        if(fetch_cached_result(&cache, opts)) {
+            free_stellar_collapse_eos_table(table);
+            if(opts->check_consistency) {
+                // The cached result is what gets checked
+                table = read_stellar_collapse_eos_table(opts->output_table_path);
+                check_consistency(table, opts);
+                free_stellar_collapse_eos_table(table);
+            }
+            return;
+        }
+    }
+    if(use_checkpoint) {
+        open_table_checkpoint(&checkpoint, opts, table);
+        hooks[n_hooks++] = make_checkpoint_hooks(&checkpoint);
+    }
+    if(use_cache) {
+        hooks[n_hooks++] = make_filter_cache(&cache);
+    }
+
+    const filter_cache chain = {load_from_hook_pair, store_to_hook_pair, hooks};
+    clean_table_cached(table, opts, n_hooks == 2 ? &chain : n_hooks == 1 ? &hooks[0] : NULL);
+    if(opts->check_consistency) {
+        check_consistency(table, opts);
+    }
+
+    // Written before the output so the original values are still available with '--in-place'
+    if(opts->patch_path[0] != '\0') {
+        write_table_patch(table, opts->input_table_path, opts->patch_path);
+        info("Successfully wrote patch to file '%s'\n", opts->patch_path);
+    }
+
+    write_clean_table(table, opts, opts->input_table_path, opts->output_table_path);
+
+    if(use_cache) {
+        store_cached_result(&cache, opts);
+    }
+    if(use_checkpoint) {
+        remove_table_checkpoint(&checkpoint);
+    }
+    flush_log();
+
+    free_stellar_collapse_eos_table(table);
+}
+
+void
+clean_table_batch(const options_t *opts)
+{
+    const int n_tables = opts->n_input_tables;
+
+    if(!opts->overlap_io) {
+        options_t table_opts = *opts;
+        for(int n = 0; n < n_tables; n++) {
+            info("Table %d of %d\n", n + 1, n_tables);
+            snprintf(table_opts.input_table_path, 1024, "%s", opts->input_table_paths[n]);
+            set_batch_output_path(opts, table_opts.input_table_path, table_opts.output_table_path);
+            clean_table_file(&table_opts);
+        }
+        return;
+    }
+
+    // Pipeline slots: the table being read, the one being cleaned, and the one being written.
+    stellar_collapse_eos *slots[3] = {NULL, NULL, NULL};
+
+#ifdef _OPENMP
+    // The cleaning stage opens its own parallel regions inside the pipeline section
+    omp_set_max_active_levels(2);
+#endif
+
+    for(int step = 0; step < n_tables + 2; step++) {
+        const int n_read  = step;
+        const int n_clean = step - 1;
+        const int n_write = step - 2;
+
+#ifdef _OPENMP
+#    pragma omp parallel sections num_threads(2)
+#endif
+        {
+#ifdef _OPENMP
+#    pragma omp section
+#endif
+            {
+                // Stage 1: write the table cleaned in the previous step (freeing it before reading the next one)
+                if(n_write >= 0) {
+                    char output_path[1034];
+                    set_batch_output_path(opts, opts->input_table_paths[n_write], output_path);
+                    write_clean_table(slots[n_write % 3], opts, opts->input_table_paths[n_write], output_path);
+                    free_stellar_collapse_eos_table(slots[n_write % 3]);
+                    slots[n_write % 3] = NULL;
+                }
+
+                // Stage 2: read the next table
+                if(n_read < n_tables) {
+                    slots[n_read % 3] = read_stellar_collapse_eos_table(opts->input_table_paths[n_read]);
+                    info("Successfully read table from file '%s'\n", opts->input_table_paths[n_read]);
+                }
+            }
+#ifdef _OPENMP
+#    pragma omp section
+#endif
+            {
+                // Stage 3: clean the table read in the previous step
+                if(n_clean >= 0 && n_clean < n_tables) {
+                    info("Cleaning table %d of %d ('%s')\n", n_clean + 1, n_tables, opts->input_table_paths[n_clean]);
+                    clean_table(slots[n_clean % 3], opts);
+                    if(opts->check_consistency) {
+                        check_consistency(slots[n_clean % 3], opts);
+                    }
+                }
+            }
+        }
+
+        // Messages of both stages, in the order they were logged
+        flush_log();
+    }
+}
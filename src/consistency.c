@@ -0,0 +1,110 @@
+#include <inttypes.h>
+#include <math.h>
+
+#include "consistency.h"
+#include "utils.h"
+
+#define INDEX(ir, it, iy) ((u64)(ir) + (u64)table->n_rho * ((u64)(it) + (u64)table->n_temperature * (u64)(iy)))
+
+const char *
+consistency_condition_to_str(const consistency_condition condition)
+{
+    switch(condition) {
+        case CONSISTENCY_PRESSURE_MONOTONIC:
+            return "pressure decreasing with density";
+        case CONSISTENCY_DEDT_POSITIVE:
+            return "negative dedt";
+        case CONSISTENCY_GAMMA_CS2:
+            return "gamma inconsistent with cs2";
+        case CONSISTENCY_ENTROPY_MONOTONIC:
+            return "entropy decreasing with temperature";
+        default:
+            return "invalid condition";
+    }
+}
+
+consistency_report
+check_table_consistency(const stellar_collapse_eos *table, u8 *mask)
+{
+    const i64 nr = table->n_rho, nt = table->n_temperature, ny = table->n_ye;
+
+    const f64 *logpress  = table->data[eos_logpress];
+    const f64 *logenergy = table->data[eos_logenergy];
+    const f64 *dedt      = table->data[eos_dedt];
+    const f64 *gamma     = table->data[eos_gamma];
+    const f64 *cs2       = table->data[eos_cs2];
+    const f64 *entropy   = table->data[eos_entropy];
+
+    u64 n_pressure = 0, n_dedt = 0, n_gamma = 0, n_entropy = 0, n_inconsistent = 0;
+
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2) reduction(+: n_pressure, n_dedt, n_gamma, n_entropy, n_inconsistent)
+#endif
+    for(i64 iy = 0; iy < ny; iy++) {
+        for(i64 it = 0; it < nt; it++) {
+            const u64 line = INDEX(0, it, iy);
+
+            // Points along rho are contiguous, and so are their neighbours in T
+#ifdef _OPENMP
+#    pragma omp simd reduction(+: n_pressure, n_dedt, n_gamma, n_entropy, n_inconsistent)
+#endif
+            for(i64 ir = 0; ir < nr; ir++) {
+                const u64 index = line + ir;
+                const f64 rho   = pow(10.0, table->log10_rho[ir]);
+                const f64 press = pow(10.0, logpress[index]);
+                const f64 eps   = pow(10.0, logenergy[index]) - table->energy_shift;
+
+                // gamma * P is the bulk modulus recovered from cs2 (see recompute_cs2_and_check_physical_limits)
+                const f64 h         = SPEED_OF_LIGHT_SQUARED_CGS + eps + press / rho;
+                const f64 gamma_cs2 = cs2[index] * rho * h / (SPEED_OF_LIGHT_SQUARED_CGS * press);
+
+                const bool pressure_bad = ir + 1 < nr && logpress[index + 1] < logpress[index];
+                const bool dedt_bad     = dedt[index] < 0;
+                const f64  gamma_error  = fabs(gamma[index] - gamma_cs2);
+                const bool gamma_bad    = gamma_error > CONSISTENCY_GAMMA_TOLERANCE * fabs(gamma[index]);
+                const bool entropy_bad  = it + 1 < nt && entropy[index + nr] < entropy[index];
+
+                const u8 bits = pressure_bad << CONSISTENCY_PRESSURE_MONOTONIC | dedt_bad << CONSISTENCY_DEDT_POSITIVE
+                              | gamma_bad << CONSISTENCY_GAMMA_CS2 | entropy_bad << CONSISTENCY_ENTROPY_MONOTONIC;
+                if(mask) {
+                    mask[index] = bits;
+                }
+                n_pressure     += pressure_bad;
+                n_dedt         += dedt_bad;
+                n_gamma        += gamma_bad;
+                n_entropy      += entropy_bad;
+                n_inconsistent += bits != 0;
+            }
+        }
+    }
+
+    const consistency_report report = {
+        (u64)nr * nt * ny,
+        n_inconsistent,
+        {n_pressure, n_dedt, n_gamma, n_entropy},
+    };
+    return report;
+}
+
+void
+print_consistency_report(const consistency_report *report)
+{
+    for(int c = 0; c < number_of_consistency_conditions; c++) {
+        info(
+            "  %-35s: %" PRIu64 " points (~%.3f%%)\n",
+            consistency_condition_to_str(c),
+            report->violations[c],
+            100.0 * report->violations[c] / report->n_points
+        );
+    }
+    if(report->n_inconsistent) {
+        warn(
+            "Found %" PRIu64 " points (~%.3f%%) that are not thermodynamically consistent\n",
+            report->n_inconsistent,
+            100.0 * report->n_inconsistent / report->n_points
+        );
+    }
+    else {
+        info("All points in the table are thermodynamically consistent!\n");
+    }
+}
@@ -0,0 +1,75 @@
+/**
+ * @file consistency.h
+ * @author Leo Werneck
+ *
+ * @brief Checks the thermodynamic consistency of EOS tables.
+ *
+ * Each point is tested against the relations simulations rely on: pressure must not decrease with density (at fixed T
+ * and Ye), dedt must not be negative, gamma must agree with cs2 (gamma = cs2 * rho * h / (c^2 * P), see
+ * recompute_cs2_and_check_physical_limits), and entropy must not decrease with temperature (at fixed rho and Ye). The
+ * monotonicity conditions use forward differences, so the last point of each line is never flagged by them.
+ */
+#ifndef CONSISTENCY_H
+#define CONSISTENCY_H
+
+#include "basic_types.h"
+#include "stellar_collapse_eos.h"
+
+#define CONSISTENCY_GAMMA_TOLERANCE (1e-2) ///< Largest relative difference allowed between gamma and the one from cs2.
+#define CONSISTENCY_MASK_DATASET    "consistency_mask" ///< Name of the mask dataset.
+
+/**
+ * @brief Conditions checked at each point. Bit 1 << condition of the mask is set where it is violated.
+ */
+typedef enum
+{
+    CONSISTENCY_PRESSURE_MONOTONIC, ///< Pressure decreases with density.
+    CONSISTENCY_DEDT_POSITIVE,      ///< dedt is negative.
+    CONSISTENCY_GAMMA_CS2,          ///< gamma disagrees with cs2.
+    CONSISTENCY_ENTROPY_MONOTONIC,  ///< Entropy decreases with temperature.
+    number_of_consistency_conditions
+} consistency_condition;
+
+/**
+ * @brief Number of points that violate each condition.
+ */
+typedef struct
+{
+    u64 n_points;                                      ///< Number of points checked.
+    u64 n_inconsistent;                                ///< Number of points that violate at least one condition.
+    u64 violations[number_of_consistency_conditions]; ///< Number of points that violate each condition.
+} consistency_report;
+
+/**
+ * @brief Returns a short description of a condition (e.g., "pressure decreasing with density").
+ */
+const char *consistency_condition_to_str(consistency_condition condition);
+
+/**
+ * @brief Checks every point of a table in a single parallel pass. No data is modified.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to check.
+ * @param mask Output array with one entry per table point holding the bits of the violated conditions, or NULL.
+ *
+ * @return The number of points that violate each condition.
+ */
+consistency_report check_table_consistency(const stellar_collapse_eos *table, u8 *mask);
+
+/**
+ * @brief Prints the number of violations of each condition.
+ */
+void print_consistency_report(const consistency_report *report);
+
+/**
+ * @brief Writes a mask to an HDF5 file, along with the table dimensions and axes.
+ *
+ * The mask is stored as a u8 dataset named CONSISTENCY_MASK_DATASET with the shape of the tabulated quantities. Its
+ * "bits" attribute describes the conditions.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure that was checked.
+ * @param mask The mask filled by check_table_consistency.
+ * @param filepath Path to the mask file.
+ */
+void write_consistency_mask(const stellar_collapse_eos *table, const u8 *mask, const char *filepath);
+
+#endif // CONSISTENCY_H
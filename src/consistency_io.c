@@ -0,0 +1,40 @@
+#include <hdf5.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "consistency.h"
+#include "hdf5_helpers.h"
+#include "utils.h"
+
+void
+write_consistency_mask(const stellar_collapse_eos *table, const u8 *mask, const char *filepath)
+{
+    hid_t file_id = create_hdf5_file(filepath);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    const hsize_t               dims[4]      = {1, table->n_ye, table->n_temperature, table->n_rho};
+    const hdf5_dataset_transfer transfers[7] = {
+        {"pointsrho",              I32, 1, dims,     (void *)&table->n_rho        },
+        {"pointstemp",             I32, 1, dims,     (void *)&table->n_temperature},
+        {"pointsye",               I32, 1, dims,     (void *)&table->n_ye         },
+        {"logrho",                 F64, 1, dims + 3, table->log10_rho             },
+        {"logtemp",                F64, 1, dims + 2, table->log10_temperature     },
+        {"ye",                     F64, 1, dims + 1, table->ye                    },
+        {CONSISTENCY_MASK_DATASET, U8,  3, dims + 1, (void *)mask                 },
+    };
+    write_hdf5_datasets(file_id, 7, transfers);
+
+    // Describe the bits, e.g., "1: pressure decreasing with density, 2: negative dedt, ..."
+    char bits[512] = "";
+    for(int c = 0; c < number_of_consistency_conditions; c++) {
+        const usize len = strlen(bits);
+        snprintf(bits + len, sizeof(bits) - len, "%s%d: %s", c ? ", " : "", 1 << c, consistency_condition_to_str(c));
+    }
+    hid_t dataset_id = H5Dopen(file_id, CONSISTENCY_MASK_DATASET, H5P_DEFAULT);
+    write_hdf5_string_attribute(dataset_id, "bits", bits);
+    H5Dclose(dataset_id);
+
+    H5Fclose(file_id);
+}
@@ -0,0 +1,349 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "decimate.h"
+#include "utils.h"
+
+/**
+ * @brief Strides and sizes of a table seen as lines along one axis.
+ */
+typedef struct
+{
+    u64 stride;       ///< Distance between consecutive lines.
+    u64 plane_stride; ///< Distance between consecutive points of the slowest other axis.
+    u64 n_fast;       ///< Points along the fastest other axis (stride 1, or n_rho when decimating rho).
+    u64 n_slow;       ///< Points along the slowest other axis.
+    u64 fast_stride;  ///< Distance between consecutive points of the fastest other axis.
+} axis_view;
+
+static axis_view
+make_axis_view(const i32 n[3], const int axis)
+{
+    const u64 strides[3] = {1, (u64)n[0], (u64)n[0] * n[1]};
+    const int fast       = axis == 0 ? 1 : 0;
+    const int slow       = axis == 2 ? 1 : 2;
+
+    axis_view view    = {0};
+    view.stride       = strides[axis];
+    view.fast_stride  = strides[fast];
+    view.plane_stride = strides[slow];
+    view.n_fast       = n[fast];
+    view.n_slow       = n[slow];
+    return view;
+}
+
+static inline f64
+max_error(const f64 current, const f64 err)
+{
+    // NaNs count as infinitely large errors
+    return isnan(err) ? INFINITY : (err > current ? err : current);
+}
+
+/**
+ * @brief Returns the largest error of interpolating the lines strictly between lo and hi from those two lines.
+ */
+static f64
+segment_error(
+    const stellar_collapse_eos          *table,
+    const axis_view                     *view,
+    const f64                           *x,
+    const i32                            lo,
+    const i32                            hi,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const f64                           *inv_scale
+)
+{
+    f64 err = 0;
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2) reduction(max : err)
+#endif
+    for(u64 s = 0; s < view->n_slow; s++) {
+        for(u64 f = 0; f < view->n_fast; f++) {
+            const u64 base = s * view->plane_stride + f * view->fast_stride;
+            f64       e    = 0;
+            for(i32 l = lo + 1; l < hi; l++) {
+                const f64 w = (x[l] - x[lo]) / (x[hi] - x[lo]);
+                for(int q = 0; q < n_qtys; q++) {
+                    const f64 *data   = table->data[qtys[q]];
+                    const f64  a      = data[base + lo * view->stride];
+                    const f64  b      = data[base + hi * view->stride];
+                    const f64  interp = a + w * (b - a);
+                    e                 = max_error(e, fabs(data[base + l * view->stride] - interp) * inv_scale[q]);
+                }
+            }
+            err = e > err ? e : err;
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief Returns true if every segment of the given stride along an axis is reproduced within the tolerance.
+ */
+static bool
+stride_meets_tolerance(
+    const stellar_collapse_eos          *table,
+    const axis_view                     *view,
+    const f64                           *x,
+    const i32                            n,
+    const i32                            stride,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const f64                           *inv_scale,
+    const f64                            tolerance
+)
+{
+    for(i32 lo = 0; lo < n - 1; lo += stride) {
+        if(!(segment_error(table, view, x, lo, lo + stride, qtys, n_qtys, inv_scale) <= tolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Selects the lines kept along an axis: every stride-th line, with the largest stride that divides n - 1 and
+ *        meets the tolerance, so that the kept lines stay uniformly spaced and include the last one.
+ *
+ * @return The number of kept lines, whose indices are stored in kept.
+ */
+static i32
+select_lines(
+    const stellar_collapse_eos          *table,
+    const int                            axis,
+    const f64                           *x,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const f64                           *inv_scale,
+    const f64                            tolerance,
+    i32                                 *kept
+)
+{
+    const i32       n[3] = {table->n_rho, table->n_temperature, table->n_ye};
+    const axis_view view = make_axis_view(n, axis);
+
+    i32 stride = n[axis] > 1 ? n[axis] - 1 : 1;
+    for(; stride > 1; stride--) {
+        if((n[axis] - 1) % stride == 0
+           && stride_meets_tolerance(table, &view, x, n[axis], stride, qtys, n_qtys, inv_scale, tolerance)) {
+            break;
+        }
+    }
+
+    i32 n_kept = 0;
+    for(i32 l = 0; l < n[axis]; l += stride) {
+        kept[n_kept++] = l;
+    }
+    return n_kept;
+}
+
+static void
+free_if_not_original(void *ptr, const void *original)
+{
+    if(ptr != original) {
+        free(ptr);
+    }
+}
+
+/**
+ * @brief Replaces the arrays of a table by the kept lines along an axis.
+ */
+static void
+compact_axis(
+    stellar_collapse_eos       *table,
+    const stellar_collapse_eos *original,
+    const int                   axis,
+    const i32                  *kept,
+    const i32                   n_kept
+)
+{
+    i32             n[3] = {table->n_rho, table->n_temperature, table->n_ye};
+    const axis_view old  = make_axis_view(n, axis);
+    n[axis]              = n_kept;
+    const axis_view new  = make_axis_view(n, axis);
+    const u64       size = (u64)n[0] * n[1] * n[2];
+
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        f64 *data = malloc_or_error(sizeof(f64) * size);
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2)
+#endif
+        for(u64 s = 0; s < new.n_slow; s++) {
+            for(i32 l = 0; l < n_kept; l++) {
+                const f64 *src = table->data[q] + s * old.plane_stride + kept[l] * old.stride;
+                f64       *dst = data + s * new.plane_stride + l * new.stride;
+                for(u64 f = 0; f < new.n_fast; f++) {
+                    dst[f * new.fast_stride] = src[f * old.fast_stride];
+                }
+            }
+        }
+        free_if_not_original(table->data[q], original->data[q]);
+        table->data[q] = data;
+    }
+
+    f64      **axes[3]     = {&table->log10_rho, &table->log10_temperature, &table->ye};
+    const f64 *old_axes[3] = {original->log10_rho, original->log10_temperature, original->ye};
+    f64       *x           = malloc_or_error(sizeof(f64) * n_kept);
+    for(i32 l = 0; l < n_kept; l++) {
+        x[l] = (*axes[axis])[kept[l]];
+    }
+    free_if_not_original(*axes[axis], old_axes[axis]);
+    *axes[axis] = x;
+
+    table->n_rho         = n[0];
+    table->n_temperature = n[1];
+    table->n_ye          = n[2];
+}
+
+/**
+ * @brief For each point of an original axis, finds the kept line below it and the interpolation weight.
+ */
+static void
+bracket_original_points(const f64 *x, const i32 n, const i32 *kept, const i32 n_kept, i32 *cell, f64 *weight)
+{
+    i32 p = 0;
+    for(i32 i = 0; i < n; i++) {
+        while(p < n_kept - 2 && kept[p + 1] <= i) {
+            p++;
+        }
+        cell[i]   = p;
+        weight[i] = n_kept > 1 ? (x[i] - x[kept[p]]) / (x[kept[p + 1]] - x[kept[p]]) : 0;
+    }
+}
+
+/**
+ * @brief Interpolates the decimated table at every original point and returns the largest error.
+ */
+static f64
+verify_decimation(
+    const stellar_collapse_eos          *table,
+    const stellar_collapse_eos          *original,
+    i32 *const                           kept[3],
+    const i32                            n_kept[3],
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const f64                           *inv_scale,
+    const f64                            tolerance,
+    u64                                 *n_exceeding
+)
+{
+    const i32  n[3]    = {original->n_rho, original->n_temperature, original->n_ye};
+    const f64 *x[3]    = {original->log10_rho, original->log10_temperature, original->ye};
+    i32       *cell[3] = {NULL, NULL, NULL};
+    f64       *w[3]    = {NULL, NULL, NULL};
+    for(int axis = 0; axis < 3; axis++) {
+        cell[axis] = malloc_or_error(sizeof(i32) * n[axis]);
+        w[axis]    = malloc_or_error(sizeof(f64) * n[axis]);
+        bracket_original_points(x[axis], n[axis], kept[axis], n_kept[axis], cell[axis], w[axis]);
+    }
+
+    // Neighbour offsets in the decimated table (zero along axes with a single line)
+    const u64 nr   = table->n_rho, nt = table->n_temperature;
+    const u64 d[3] = {n_kept[0] > 1 ? 1 : 0, n_kept[1] > 1 ? nr : 0, n_kept[2] > 1 ? nr * nt : 0};
+
+    f64 err       = 0;
+    u64 exceeding = 0;
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2) reduction(max : err) reduction(+ : exceeding)
+#endif
+    for(i32 k = 0; k < n[2]; k++) {
+        for(i32 j = 0; j < n[1]; j++) {
+            for(i32 i = 0; i < n[0]; i++) {
+                const u64 b     = cell[0][i] + nr * (cell[1][j] + nt * cell[2][k]);
+                const u64 index = i + (u64)n[0] * (j + (u64)n[1] * k);
+                const f64 wr = w[0][i], wt = w[1][j], wy = w[2][k];
+                f64       e  = 0;
+                for(int q = 0; q < n_qtys; q++) {
+                    const f64 *v   = table->data[qtys[q]];
+                    const f64  c00 = v[b] + wr * (v[b + d[0]] - v[b]);
+                    const f64  c10 = v[b + d[1]] + wr * (v[b + d[1] + d[0]] - v[b + d[1]]);
+                    const f64  c01 = v[b + d[2]] + wr * (v[b + d[2] + d[0]] - v[b + d[2]]);
+                    const f64  c11 = v[b + d[2] + d[1]] + wr * (v[b + d[2] + d[1] + d[0]] - v[b + d[2] + d[1]]);
+                    const f64  c0  = c00 + wt * (c10 - c00);
+                    const f64  c1  = c01 + wt * (c11 - c01);
+                    const f64  f   = c0 + wy * (c1 - c0);
+                    e              = max_error(e, fabs(original->data[qtys[q]][index] - f) * inv_scale[q]);
+                }
+                exceeding += !(e <= tolerance);
+                err        = e > err ? e : err;
+            }
+        }
+    }
+
+    for(int axis = 0; axis < 3; axis++) {
+        free(cell[axis]);
+        free(w[axis]);
+    }
+
+    *n_exceeding = exceeding;
+    return err;
+}
+
+u64
+decimate_table(
+    stellar_collapse_eos                *table,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const f64                            tolerance
+)
+{
+    const stellar_collapse_eos original = *table;
+    const u64                  size     = (u64)original.n_rho * original.n_temperature * original.n_ye;
+
+    // Errors are relative to the range of each quantity
+    f64 inv_scale[number_of_eos_quantities];
+    for(int q = 0; q < n_qtys; q++) {
+        const f64 *data = original.data[qtys[q]];
+        f64        min = INFINITY, max = -INFINITY;
+#ifdef _OPENMP
+#    pragma omp parallel for reduction(min : min) reduction(max : max)
+#endif
+        for(u64 i = 0; i < size; i++) {
+            min = data[i] < min ? data[i] : min;
+            max = data[i] > max ? data[i] : max;
+        }
+        inv_scale[q] = max > min ? 1.0 / (max - min) : 1.0;
+    }
+
+    const i32   n[3]     = {original.n_rho, original.n_temperature, original.n_ye};
+    const char *names[3] = {"logrho", "logtemp", "ye"};
+    i32        *kept[3]  = {NULL, NULL, NULL};
+    i32         n_kept[3];
+    for(int axis = 0; axis < 3; axis++) {
+        const f64 *x[3] = {table->log10_rho, table->log10_temperature, table->ye};
+        kept[axis]      = malloc_or_error(sizeof(i32) * n[axis]);
+        n_kept[axis]    = select_lines(table, axis, x[axis], qtys, n_qtys, inv_scale, tolerance / 3, kept[axis]);
+        info("  %-9s: %d -> %d points\n", names[axis], n[axis], n_kept[axis]);
+        if(n_kept[axis] < n[axis]) {
+            compact_axis(table, &original, axis, kept[axis], n_kept[axis]);
+        }
+    }
+
+    u64       n_exceeding = 0;
+    const f64 err =
+        verify_decimation(table, &original, kept, n_kept, qtys, n_qtys, inv_scale, tolerance, &n_exceeding);
+    const u64 new_size = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    info(
+        "Decimated table has %.1f%% of the points; max error %.3e (relative to the range of each quantity)\n",
+        100.0 * new_size / size,
+        err
+    );
+
+    // The decimated table owns new arrays only along the axes that were decimated
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        free_if_not_original(original.data[q], table->data[q]);
+        table->modified_ye_begin[q] = 0;
+        table->modified_ye_end[q]   = table->n_ye;
+    }
+    free_if_not_original(original.log10_rho, table->log10_rho);
+    free_if_not_original(original.log10_temperature, table->log10_temperature);
+    free_if_not_original(original.ye, table->ye);
+    for(int axis = 0; axis < 3; axis++) {
+        free(kept[axis]);
+    }
+
+    return n_exceeding;
+}
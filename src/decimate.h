@@ -0,0 +1,40 @@
+/**
+ * @file decimate.h
+ * @author Leo Werneck
+ *
+ * @brief Removes grid lines that can be reproduced by interpolating from their neighbours.
+ *
+ * Each axis is decimated in turn by keeping every k-th line, with the largest stride k for which linear interpolation
+ * (in log10_rho, log10_T, or Ye) between consecutive kept lines reproduces every line in between within the tolerance.
+ * Errors are measured relative to the range of each quantity, and each axis gets a third of the tolerance so that
+ * trilinear interpolation of the decimated table stays within it. The stride must divide the number of intervals of
+ * the axis, so that the first and last lines are always kept and a uniform axis stays uniform: the decimated table
+ * can be read by every code that reads the original one.
+ */
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include "basic_types.h"
+#include "stellar_collapse_eos.h"
+
+/**
+ * @brief Decimates a table in place.
+ *
+ * The grid and data arrays of the table are replaced by smaller ones. Afterwards, the decimated table is interpolated
+ * at every point of the original grid to measure the error actually achieved, which is reported.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to decimate.
+ * @param qtys Quantities that must be reproduced within the tolerance (the others are just subsampled).
+ * @param n_qtys Number of quantities.
+ * @param tolerance Largest error allowed, relative to the range of each quantity.
+ *
+ * @return The number of points of the original grid where the error exceeds the tolerance.
+ */
+u64 decimate_table(
+    stellar_collapse_eos                *table,
+    const stellar_collapse_eos_quantity *qtys,
+    int                                  n_qtys,
+    f64                                  tolerance
+);
+
+#endif // DECIMATE_H
@@ -0,0 +1,161 @@
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "cleaner.h"
+#include "eos_cleaner.h"
+#include "utils.h"
+
+// The public header cannot include the internal ones, so it repeats the number of quantities
+typedef char eos_cleaner_n_quantities_check[EOS_CLEANER_N_QUANTITIES == number_of_eos_quantities ? 1 : -1];
+
+static char api_error[256] = "";
+
+eos_cleaner_settings
+eos_cleaner_default_settings(void)
+{
+    const eos_cleaner_settings settings = {EOS_CLEANER_SMOOTH_DERIVS_ONLY, EOS_CLEANER_DERIVS_SMOOTH, false};
+    return settings;
+}
+
+static eos_cleaner_status
+invalid_argument(const char *message)
+{
+    snprintf(api_error, sizeof(api_error), "%s", message);
+    return EOS_CLEANER_INVALID_ARGUMENT;
+}
+
+static smoother_t
+get_smoother(const eos_cleaner_smoothing smoother)
+{
+    switch(smoother) {
+        case EOS_CLEANER_SMOOTH_NONE:
+            return SMOOTH_NONE;
+        case EOS_CLEANER_SMOOTH_DERIVS_ONLY:
+            return SMOOTH_DERIVS_ONLY;
+        case EOS_CLEANER_SMOOTH_HYDRO_ONLY:
+            return SMOOTH_HYDRO_ONLY;
+        case EOS_CLEANER_SMOOTH_ALL:
+            return SMOOTH_ALL;
+    }
+    return SMOOTH_INVALID;
+}
+
+static derivs_t
+get_derivs(const eos_cleaner_derivs derivs)
+{
+    switch(derivs) {
+        case EOS_CLEANER_DERIVS_SMOOTH:
+            return DERIVS_SMOOTH;
+        case EOS_CLEANER_DERIVS_RECOMPUTE:
+            return DERIVS_RECOMPUTE;
+        case EOS_CLEANER_DERIVS_DO_NOTHING:
+            return DERIVS_DO_NOTHING;
+    }
+    return DERIVS_INVALID;
+}
+
+static eos_cleaner_status
+get_status(const error_t code)
+{
+    switch(code) {
+        case SUCCESS:
+            return EOS_CLEANER_SUCCESS;
+        case OUT_OF_MEMORY:
+            return EOS_CLEANER_OUT_OF_MEMORY;
+        case INVALID_ARGUMENT:
+        case INVALID_SMOOTHER:
+        case INVALID_DERIVS:
+            return EOS_CLEANER_INVALID_ARGUMENT;
+        case UNSUPPORTED_FEATURE:
+            return EOS_CLEANER_UNSUPPORTED_FEATURE;
+        case INVALID_TABLE:
+            return EOS_CLEANER_INVALID_TABLE;
+        default:
+            return EOS_CLEANER_INTERNAL_ERROR;
+    }
+}
+
+eos_cleaner_status
+eos_cleaner_clean(
+    const int32_t               n_rho,
+    const int32_t               n_temperature,
+    const int32_t               n_ye,
+    const double               *log10_rho,
+    const double               *log10_temperature,
+    const double               *ye,
+    const double                energy_shift,
+    double *const              *data,
+    const eos_cleaner_settings *settings
+)
+{
+    const eos_cleaner_settings defaults = eos_cleaner_default_settings();
+    if(!settings) {
+        settings = &defaults;
+    }
+
+    api_error[0] = '\0';
+    if(n_rho < 1 || n_temperature < 1 || n_ye < 1) {
+        return invalid_argument("Table dimensions must be positive.");
+    }
+    if(!log10_rho || !log10_temperature || !ye || !data) {
+        return invalid_argument("Table axes and data must not be NULL.");
+    }
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!data[n]) {
+            return invalid_argument("Table data must not be NULL.");
+        }
+    }
+
+    options_t opts = {0};
+    opts.smoother  = get_smoother(settings->smoother);
+    opts.derivs    = get_derivs(settings->derivs);
+    if(opts.smoother == SMOOTH_INVALID || opts.derivs == DERIVS_INVALID) {
+        return invalid_argument("Invalid smoothing or derivative option.");
+    }
+    if(opts.derivs == DERIVS_RECOMPUTE) {
+        snprintf(api_error, sizeof(api_error), "Recompute derivatives it not yet supported.");
+        return EOS_CLEANER_UNSUPPORTED_FEATURE;
+    }
+
+    // Non-owning view of the caller's arrays; none of the stages modify the axes
+    stellar_collapse_eos table = {0};
+    table.n_rho                = n_rho;
+    table.n_temperature        = n_temperature;
+    table.n_ye                 = n_ye;
+    table.log10_rho            = (f64 *)log10_rho;
+    table.log10_temperature    = (f64 *)log10_temperature;
+    table.ye                   = (f64 *)ye;
+    table.energy_shift         = energy_shift;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        table.data[n] = data[n];
+    }
+
+    const bool info_enabled = set_info_messages_enabled(settings->verbose);
+
+    jmp_buf trap;
+    if(setjmp(trap) != 0) {
+        flush_log();
+        set_error_trap(NULL);
+        set_info_messages_enabled(info_enabled);
+        return get_status(last_error_code());
+    }
+    set_error_trap(&trap);
+
+    const u64 problems = clean_table(&table, &opts);
+    flush_log();
+
+    set_error_trap(NULL);
+    set_info_messages_enabled(info_enabled);
+
+    if(problems) {
+        snprintf(api_error, sizeof(api_error), "Cleaned table failed validation (%" PRIu64 " problems).", problems);
+        return EOS_CLEANER_INVALID_TABLE;
+    }
+    return EOS_CLEANER_SUCCESS;
+}
+
+const char *
+eos_cleaner_last_error(void)
+{
+    return api_error[0] != '\0' ? api_error : last_error_message();
+}
@@ -0,0 +1,122 @@
+/**
+ * @file eos_cleaner.h
+ * @author Leo Werneck
+ *
+ * @brief C API of libeoscleaner, which cleans EOS tables held in caller-owned memory.
+ *
+ * The library does not depend on HDF5 and never terminates the calling program: all errors are reported through
+ * return codes. Build it with 'make lib'. This header is self-contained and can be included from C and C++; the
+ * shared library only exports the eos_cleaner_* functions.
+ */
+#ifndef EOS_CLEANER_H
+#define EOS_CLEANER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#    define EOS_CLEANER_API __attribute__((visibility("default"))) ///< Marks the functions exported by the library.
+#else
+#    define EOS_CLEANER_API
+#endif
+
+#define EOS_CLEANER_N_QUANTITIES (19) ///< Number of tabulated quantities (see eos_cleaner_clean).
+
+/**
+ * @brief Status codes returned by the library.
+ */
+typedef enum
+{
+    EOS_CLEANER_SUCCESS,             ///< The table was cleaned.
+    EOS_CLEANER_OUT_OF_MEMORY,       ///< A work buffer could not be allocated.
+    EOS_CLEANER_INVALID_ARGUMENT,    ///< An argument is invalid (e.g., a NULL pointer or a non-positive dimension).
+    EOS_CLEANER_UNSUPPORTED_FEATURE, ///< The settings request a feature that is not supported.
+    EOS_CLEANER_INVALID_TABLE,       ///< The cleaned table still contains NaNs, infinities, or non-monotonic axes.
+    EOS_CLEANER_INTERNAL_ERROR,      ///< Any other error (see eos_cleaner_last_error).
+} eos_cleaner_status;
+
+/**
+ * @brief Quantities the median filter is applied to.
+ */
+typedef enum
+{
+    EOS_CLEANER_SMOOTH_NONE,        ///< No quantities (for debugging).
+    EOS_CLEANER_SMOOTH_DERIVS_ONLY, ///< dpdrhoe, dpderho, and dedt (default).
+    EOS_CLEANER_SMOOTH_HYDRO_ONLY,  ///< All quantities except the derivatives.
+    EOS_CLEANER_SMOOTH_ALL,         ///< All quantities.
+} eos_cleaner_smoothing;
+
+/**
+ * @brief What to do with the derivatives when smoothing all quantities.
+ */
+typedef enum
+{
+    EOS_CLEANER_DERIVS_SMOOTH,     ///< Smooth them like the other quantities (default).
+    EOS_CLEANER_DERIVS_RECOMPUTE,  ///< Recompute them (not yet supported).
+    EOS_CLEANER_DERIVS_DO_NOTHING, ///< Leave them unchanged (for debugging).
+} eos_cleaner_derivs;
+
+/**
+ * @brief Settings for eos_cleaner_clean.
+ */
+typedef struct
+{
+    eos_cleaner_smoothing smoother; ///< Which quantities to apply the median filter to.
+    eos_cleaner_derivs    derivs;   ///< What to do with the derivatives when smoothing all quantities.
+    bool                  verbose;  ///< Whether to print informational messages (warnings are always printed).
+} eos_cleaner_settings;
+
+/**
+ * @brief Returns the settings used by the command line tool by default.
+ */
+EOS_CLEANER_API eos_cleaner_settings eos_cleaner_default_settings(void);
+
+/**
+ * @brief Cleans an EOS table in place.
+ *
+ * Applies the median filter, recomputes cs2, and validates the table. The data arrays are laid out as in the
+ * stellarcollapse.org tables, i.e., index = ir + n_rho * (it + n_temperature * iy), and are ordered as Abar, Xa, Xh,
+ * Xn, Xp, Zbar, cs2, dedt, dpderho, dpdrhoe, entropy, gamma, logenergy, logpress, mu_e, mu_n, mu_p, muhat, munu. The
+ * caller keeps ownership of all arrays.
+ *
+ * @param n_rho Number of density points.
+ * @param n_temperature Number of temperature points.
+ * @param n_ye Number of electron fraction points.
+ * @param log10_rho Density axis, log10(rho) (n_rho points).
+ * @param log10_temperature Temperature axis, log10(T) (n_temperature points).
+ * @param ye Electron fraction axis (n_ye points).
+ * @param energy_shift Energy shift applied to the specific internal energy.
+ * @param data Array of EOS_CLEANER_N_QUANTITIES pointers to the tabulated quantities, modified in place.
+ * @param settings Pointer to the settings, or NULL for eos_cleaner_default_settings().
+ *
+ * @return EOS_CLEANER_SUCCESS, EOS_CLEANER_INVALID_TABLE if the cleaned table still contains NaNs, infinities, or
+ *         non-monotonic axes, or the status of the error that stopped the cleaning (see eos_cleaner_last_error).
+ *
+ * @note Not thread-safe: concurrent calls from different threads are not supported.
+ */
+EOS_CLEANER_API eos_cleaner_status eos_cleaner_clean(
+    const int32_t               n_rho,
+    const int32_t               n_temperature,
+    const int32_t               n_ye,
+    const double               *log10_rho,
+    const double               *log10_temperature,
+    const double               *ye,
+    const double                energy_shift,
+    double *const              *data,
+    const eos_cleaner_settings *settings
+);
+
+/**
+ * @brief Returns a description of the last error reported by eos_cleaner_clean.
+ */
+EOS_CLEANER_API const char *eos_cleaner_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EOS_CLEANER_H
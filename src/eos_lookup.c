@@ -0,0 +1,221 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eos_lookup.h"
+#include "utils.h"
+
+static void
+set_uniform_axis(eos_lookup *lookup, const int axis, const f64 *x, const i32 n, const char *name)
+{
+    if(n < 2) {
+        error(INVALID_TABLE, "Axis '%s' needs at least two points for interpolation\n", name);
+    }
+
+    const f64 spacing = (x[n - 1] - x[0]) / (n - 1);
+    for(i32 i = 1; i < n; i++) {
+        if(fabs(x[i] - x[i - 1] - spacing) > 1e-6 * fabs(spacing)) {
+            error(INVALID_TABLE, "Axis '%s' is not uniform (point %d)\n", name, i);
+        }
+    }
+
+    lookup->n[axis]           = n;
+    lookup->origin[axis]      = x[0];
+    lookup->inv_spacing[axis] = 1.0 / spacing;
+}
+
+eos_lookup
+make_eos_lookup(
+    const stellar_collapse_eos          *table,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const interleaved_layout            *layout,
+    const f64                           *records
+)
+{
+    if(n_qtys < 1 || n_qtys > number_of_eos_quantities) {
+        error(INVALID_ARGUMENT, "Lookups need between 1 and %d quantities\n", number_of_eos_quantities);
+    }
+
+    eos_lookup lookup = {0};
+    lookup.table      = table;
+    lookup.layout     = layout;
+    lookup.records    = records;
+    lookup.n_qtys     = n_qtys;
+    memcpy(lookup.qtys, qtys, sizeof(stellar_collapse_eos_quantity) * n_qtys);
+
+    if(layout) {
+        // The record offset of a point is a sum of one term per axis (see interleaved_record_offset)
+        const u64 b         = layout->tile;
+        const u64 tile_rho  = b * b * b;
+        const u64 tile_T    = tile_rho * layout->n_tiles[0];
+        const u64 tile_ye   = tile_T * layout->n_tiles[1];
+        const u64 scale[3]  = {tile_rho, tile_T, tile_ye};
+        const u64 within[3] = {1, b, b * b};
+        const i32 n_axis[3] = {table->n_rho, table->n_temperature, table->n_ye};
+        for(int axis = 0; axis < 3; axis++) {
+            lookup.record_offsets[axis] = malloc_or_error(sizeof(u64) * n_axis[axis]);
+            for(i32 i = 0; i < n_axis[axis]; i++) {
+                lookup.record_offsets[axis][i] = ((i / b) * scale[axis] + (i % b) * within[axis]) * layout->stride;
+            }
+        }
+
+        for(int q = 0; q < n_qtys; q++) {
+            lookup.slots[q] = -1;
+            for(int s = 0; s < layout->n_qtys; s++) {
+                if(layout->qtys[s] == qtys[q]) {
+                    lookup.slots[q] = s;
+                }
+            }
+            if(lookup.slots[q] < 0) {
+                error(INVALID_ARGUMENT, "Quantity '%s' is not interleaved\n", stellar_collapse_qty_to_str(qtys[q]));
+            }
+        }
+    }
+
+    set_uniform_axis(&lookup, 0, table->log10_rho, table->n_rho, "logrho");
+    set_uniform_axis(&lookup, 1, table->log10_temperature, table->n_temperature, "logtemp");
+    set_uniform_axis(&lookup, 2, table->ye, table->n_ye, "ye");
+
+    return lookup;
+}
+
+void
+free_eos_lookup(eos_lookup *lookup)
+{
+    for(int axis = 0; axis < 3; axis++) {
+        free(lookup->record_offsets[axis]);
+        lookup->record_offsets[axis] = NULL;
+    }
+}
+
+static inline void
+locate(const f64 x, const f64 origin, const f64 inv_spacing, const i32 n, i32 *cell, f64 *weight)
+{
+    // Clamp to the grid, and the cell to [0, n - 2] so that its upper corner exists
+    f64 s = (x - origin) * inv_spacing;
+    s     = s < 0 ? 0 : (s > n - 1 ? n - 1 : s);
+    i32 c = (i32)s;
+    c     = c > n - 2 ? n - 2 : c;
+
+    *cell   = c;
+    *weight = s - c;
+}
+
+static inline f64
+trilinear(const f64 *v, const f64 wr, const f64 wt, const f64 wy)
+{
+    // Corners ordered as (rho, T, Ye) = 000, 100, 010, 110, 001, 101, 011, 111
+    const f64 c00 = v[0] + wr * (v[1] - v[0]);
+    const f64 c10 = v[2] + wr * (v[3] - v[2]);
+    const f64 c01 = v[4] + wr * (v[5] - v[4]);
+    const f64 c11 = v[6] + wr * (v[7] - v[6]);
+    const f64 c0  = c00 + wt * (c10 - c00);
+    const f64 c1  = c01 + wt * (c11 - c01);
+    return c0 + wy * (c1 - c0);
+}
+
+static void
+lookup_block_planar(const eos_lookup *lookup, const int n, const i32 (*cells)[3], const f64 (*weights)[3], f64 *out)
+{
+    const u64 nr = lookup->n[0];
+    const u64 nt = lookup->n[1];
+
+    for(i32 q = 0; q < lookup->n_qtys; q++) {
+        const f64 *data = lookup->table->data[lookup->qtys[q]];
+#ifdef _OPENMP
+#    pragma omp simd
+#endif
+        for(int p = 0; p < n; p++) {
+            const u64 b    = cells[p][0] + nr * (cells[p][1] + nt * cells[p][2]);
+            const f64 v[8] = {
+                data[b],
+                data[b + 1],
+                data[b + nr],
+                data[b + nr + 1],
+                data[b + nr * nt],
+                data[b + nr * nt + 1],
+                data[b + nr * nt + nr],
+                data[b + nr * nt + nr + 1],
+            };
+            out[p * lookup->n_qtys + q] = trilinear(v, weights[p][0], weights[p][1], weights[p][2]);
+        }
+    }
+}
+
+static void
+lookup_block_interleaved(
+    const eos_lookup *lookup,
+    const int         n,
+    const i32 (*cells)[3],
+    const f64 (*weights)[3],
+    f64 *out
+)
+{
+    const u64 *offset_rho = lookup->record_offsets[0];
+    const u64 *offset_T   = lookup->record_offsets[1];
+    const u64 *offset_ye  = lookup->record_offsets[2];
+
+    for(int p = 0; p < n; p++) {
+        const i32  i = cells[p][0], j = cells[p][1], k = cells[p][2];
+        const f64 *r[8];
+        for(int c = 0; c < 8; c++) {
+            const u64 offset = offset_rho[i + (c & 1)] + offset_T[j + ((c >> 1) & 1)] + offset_ye[k + (c >> 2)];
+            r[c]             = lookup->records + offset;
+        }
+
+        f64 *o = out + p * lookup->n_qtys;
+#ifdef _OPENMP
+#    pragma omp simd
+#endif
+        for(i32 q = 0; q < lookup->n_qtys; q++) {
+            const i32 s    = lookup->slots[q];
+            const f64 v[8] = {r[0][s], r[1][s], r[2][s], r[3][s], r[4][s], r[5][s], r[6][s], r[7][s]};
+            o[q]           = trilinear(v, weights[p][0], weights[p][1], weights[p][2]);
+        }
+    }
+}
+
+void
+eos_lookup_batch(
+    const eos_lookup *lookup,
+    const u64         n_points,
+    const f64        *log10_rho,
+    const f64        *log10_temperature,
+    const f64        *ye,
+    f64              *out
+)
+{
+    const i64 n_blocks = (n_points + LOOKUP_BLOCK - 1) / LOOKUP_BLOCK;
+
+#ifdef _OPENMP
+#    pragma omp parallel for schedule(static)
+#endif
+    for(i64 block = 0; block < n_blocks; block++) {
+        const u64 first = block * LOOKUP_BLOCK;
+        const int n     = n_points - first < LOOKUP_BLOCK ? (int)(n_points - first) : LOOKUP_BLOCK;
+
+        const f64 *x0  = lookup->origin;
+        const f64 *idx = lookup->inv_spacing;
+        const i32 *nx  = lookup->n;
+
+        i32 cells[LOOKUP_BLOCK][3];
+        f64 weights[LOOKUP_BLOCK][3];
+#ifdef _OPENMP
+#    pragma omp simd
+#endif
+        for(int p = 0; p < n; p++) {
+            locate(log10_rho[first + p], x0[0], idx[0], nx[0], &cells[p][0], &weights[p][0]);
+            locate(log10_temperature[first + p], x0[1], idx[1], nx[1], &cells[p][1], &weights[p][1]);
+            locate(ye[first + p], x0[2], idx[2], nx[2], &cells[p][2], &weights[p][2]);
+        }
+
+        f64 *block_out = out + first * lookup->n_qtys;
+        if(lookup->layout) {
+            lookup_block_interleaved(lookup, n, (const i32(*)[3])cells, (const f64(*)[3])weights, block_out);
+        }
+        else {
+            lookup_block_planar(lookup, n, (const i32(*)[3])cells, (const f64(*)[3])weights, block_out);
+        }
+    }
+}
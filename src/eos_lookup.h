@@ -0,0 +1,83 @@
+/**
+ * @file eos_lookup.h
+ * @author Leo Werneck
+ *
+ * @brief Batched trilinear interpolation of EOS quantities in (log10_rho, log10_T, Ye).
+ *
+ * The grids of stellar collapse tables are uniform, so the cell of a point is found in O(1) from its coordinates.
+ * Points are processed in blocks: the cells and weights of a block are computed in one vectorized loop, and the
+ * interpolation then runs over the block (planar layout) or over the quantities of each record (interleaved layout).
+ * Points outside the grid are clamped to its boundary.
+ */
+#ifndef EOS_LOOKUP_H
+#define EOS_LOOKUP_H
+
+#include "basic_types.h"
+#include "interleaved_layout.h"
+#include "stellar_collapse_eos.h"
+
+#define LOOKUP_BLOCK (32) ///< Number of points whose cells are located together.
+
+/**
+ * @brief Precomputed state for looking up a set of quantities in a table.
+ */
+typedef struct
+{
+    const stellar_collapse_eos   *table;                           ///< Table with the grid (and planar data).
+    const interleaved_layout     *layout;                          ///< Record layout, or NULL for the planar arrays.
+    const f64                    *records;                         ///< Interleaved records (if layout is not NULL).
+    i32                           n_qtys;                          ///< Number of quantities returned per point.
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];  ///< Quantities returned per point, in order.
+    i32                           slots[number_of_eos_quantities]; ///< Position of each quantity in a record.
+    i32                           n[3];                            ///< Grid points along log10_rho, log10_T, and Ye.
+    f64                           origin[3];                       ///< First grid point along each axis.
+    f64                           inv_spacing[3];                  ///< Inverse grid spacing along each axis.
+    u64                          *record_offsets[3];               ///< Record offset of each grid index per axis.
+} eos_lookup;
+
+/**
+ * @brief Prepares lookups of a set of quantities.
+ *
+ * The axes of the table must be uniform and have at least two points.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure.
+ * @param qtys Quantities to return for each point, in order.
+ * @param n_qtys Number of quantities.
+ * @param layout Layout of the interleaved records, or NULL to interpolate the planar arrays of the table.
+ * @param records Interleaved records (ignored if layout is NULL). Every quantity must be in the records.
+ *
+ * @return The lookup state, to be freed with free_eos_lookup.
+ */
+eos_lookup make_eos_lookup(
+    const stellar_collapse_eos          *table,
+    const stellar_collapse_eos_quantity *qtys,
+    int                                  n_qtys,
+    const interleaved_layout            *layout,
+    const f64                           *records
+);
+
+/**
+ * @brief Frees the memory allocated by make_eos_lookup.
+ */
+void free_eos_lookup(eos_lookup *lookup);
+
+/**
+ * @brief Interpolates the quantities of a lookup at a batch of points.
+ *
+ * @param lookup The lookup state.
+ * @param n_points Number of points.
+ * @param log10_rho Log10 of the density of each point.
+ * @param log10_temperature Log10 of the temperature of each point.
+ * @param ye Electron fraction of each point.
+ * @param out Output with n_points * n_qtys values; the quantities of each point are stored contiguously.
+ */
+void eos_lookup_batch(
+    const eos_lookup *lookup,
+    u64               n_points,
+    const f64        *log10_rho,
+    const f64        *log10_temperature,
+    const f64        *ye,
+    f64              *out
+);
+
+#endif // EOS_LOOKUP_H
@@ -0,0 +1,67 @@
+#include <string.h>
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include "execution_profile.h"
+#include "median_filter.h"
+
+static execution_profile profile = {0, MF_TILE, 0, SCHEDULE_STATIC, 3};
+
+execution_profile
+default_execution_profile(void)
+{
+    const execution_profile defaults = {0, MF_TILE, 0, SCHEDULE_STATIC, 3};
+    return defaults;
+}
+
+const execution_profile *
+get_execution_profile(void)
+{
+    return &profile;
+}
+
+void
+set_execution_profile(const execution_profile *new_profile)
+{
+    profile = *new_profile;
+}
+
+const char *
+schedule_to_str(const schedule_t schedule)
+{
+    switch(schedule) {
+        case SCHEDULE_STATIC:
+            return "static";
+        case SCHEDULE_DYNAMIC:
+            return "dynamic";
+        case SCHEDULE_GUIDED:
+            return "guided";
+        default:
+            return "invalid";
+    }
+}
+
+schedule_t
+schedule_from_str(const char *str)
+{
+    for(schedule_t schedule = SCHEDULE_STATIC; schedule <= SCHEDULE_GUIDED; schedule++) {
+        if(!strcmp(str, schedule_to_str(schedule))) {
+            return schedule;
+        }
+    }
+    return SCHEDULE_INVALID;
+}
+
+void
+set_runtime_schedule(const schedule_t schedule)
+{
+#ifdef _OPENMP
+    // A chunk size of 0 selects the default of each schedule
+    const omp_sched_t kinds[] = {omp_sched_static, omp_sched_dynamic, omp_sched_guided};
+    omp_set_schedule(kinds[schedule], 0);
+#else
+    (void)schedule;
+#endif
+}
@@ -0,0 +1,66 @@
+/**
+ * @file execution_profile.h
+ * @author Leo Werneck
+ *
+ * @brief Execution choices (threads, tiles, schedules, and loop collapsing) of the parallel kernels.
+ *
+ * The defaults reproduce the behaviour of builds without profiles. Profiles tuned for a machine are written by
+ * '--calibrate' and loaded automatically (see calibrate.h).
+ */
+#ifndef EXECUTION_PROFILE_H
+#define EXECUTION_PROFILE_H
+
+/**
+ * @brief OpenMP schedules the cs2 loop can use.
+ */
+typedef enum
+{
+    SCHEDULE_INVALID = -1,
+    SCHEDULE_STATIC,
+    SCHEDULE_DYNAMIC,
+    SCHEDULE_GUIDED,
+} schedule_t;
+
+/**
+ * @brief Execution choices of apply_median_filter_to_quantities and recompute_cs2_and_check_physical_limits.
+ */
+typedef struct
+{
+    int        filter_threads; ///< Threads of the median filter (0 for the OpenMP default).
+    int        filter_tile;    ///< Edge of the median filter tiles along temperature and Ye (see MF_TILE).
+    int        cs2_threads;    ///< Threads of the cs2 recomputation (0 for the OpenMP default).
+    schedule_t cs2_schedule;   ///< Schedule of the cs2 loop.
+    int        cs2_collapse;   ///< Loops collapsed in the cs2 loop: 2 (Ye and T) or 3 (Ye, T, and rho).
+} execution_profile;
+
+/**
+ * @brief Returns the default execution profile.
+ */
+execution_profile default_execution_profile(void);
+
+/**
+ * @brief Returns the execution profile used by the kernels.
+ */
+const execution_profile *get_execution_profile(void);
+
+/**
+ * @brief Sets the execution profile used by the kernels.
+ */
+void set_execution_profile(const execution_profile *profile);
+
+/**
+ * @brief Returns the name of a schedule (e.g., "static").
+ */
+const char *schedule_to_str(schedule_t schedule);
+
+/**
+ * @brief Returns the schedule with the given name, or SCHEDULE_INVALID if there is none.
+ */
+schedule_t schedule_from_str(const char *str);
+
+/**
+ * @brief Sets the schedule of the loops with schedule(runtime) started by the calling thread.
+ */
+void set_runtime_schedule(schedule_t schedule);
+
+#endif // EXECUTION_PROFILE_H
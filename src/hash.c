@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "utils.h"
+
+#define PRIME64_1 (0x9E3779B185EBCA87ULL)
+#define PRIME64_2 (0xC2B2AE3D27D4EB4FULL)
+#define PRIME64_3 (0x165667B19E3779F9ULL)
+#define PRIME64_4 (0x85EBCA77C2B2AE63ULL)
+#define PRIME64_5 (0x27D4EB2F165667C5ULL)
+
+static inline u64
+rotl64(const u64 x, const int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline u64
+read64(const u8 *p)
+{
+    u64 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline u32
+read32(const u8 *p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline u64
+xxh64_round(u64 acc, const u64 input)
+{
+    acc += input * PRIME64_2;
+    acc  = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline u64
+xxh64_merge(u64 acc, const u64 val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+u64
+xxh64(const void *data, const u64 size, const u64 seed)
+{
+    const u8 *p   = (const u8 *)data;
+    const u8 *end = p + size;
+    u64       h;
+
+    if(size >= 32) {
+        u64 v1 = seed + PRIME64_1 + PRIME64_2;
+        u64 v2 = seed + PRIME64_2;
+        u64 v3 = seed;
+        u64 v4 = seed - PRIME64_1;
+        for(; p + 32 <= end; p += 32) {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    }
+    else {
+        h = seed + PRIME64_5;
+    }
+
+    h += size;
+    for(; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, read64(p));
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if(p + 4 <= end) {
+        h ^= read32(p) * PRIME64_1;
+        h  = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for(; p < end; p++) {
+        h ^= *p * PRIME64_5;
+        h  = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+u64
+parallel_hash(const void *data, const u64 size, const u64 seed)
+{
+    const u8 *bytes    = (const u8 *)data;
+    const i64 n_chunks = (size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+    u64      *hashes   = malloc_or_error(sizeof(u64) * (n_chunks ? n_chunks : 1));
+
+#ifdef _OPENMP
+#    pragma omp parallel for schedule(static)
+#endif
+    for(i64 c = 0; c < n_chunks; c++) {
+        const u64 offset = (u64)c * HASH_CHUNK_SIZE;
+        const u64 len    = size - offset < HASH_CHUNK_SIZE ? size - offset : HASH_CHUNK_SIZE;
+        hashes[c]        = xxh64(bytes + offset, len, seed);
+    }
+
+    const u64 h = xxh64(hashes, sizeof(u64) * n_chunks, seed ^ size);
+    free(hashes);
+    return h;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file hash.h
+ * @author Leo Werneck
+ *
+ * @brief Fast non-cryptographic hashing (XXH64) of table data.
+ */
+#ifndef HASH_H
+#define HASH_H
+
+#include "basic_types.h"
+
+#define HASH_CHUNK_SIZE (1 << 20) ///< Bytes hashed by each task in parallel_hash.
+
+/**
+ * @brief Computes the XXH64 hash of a buffer.
+ *
+ * @param data The buffer.
+ * @param size Size of the buffer in bytes.
+ * @param seed The seed.
+ */
+u64 xxh64(const void *data, u64 size, u64 seed);
+
+/**
+ * @brief Hashes a large buffer in parallel.
+ *
+ * The buffer is split in chunks of HASH_CHUNK_SIZE bytes that are hashed concurrently, and the result is the hash of
+ * the chunk hashes, so it does not depend on the number of threads (but differs from xxh64 of the whole buffer).
+ *
+ * @param data The buffer.
+ * @param size Size of the buffer in bytes.
+ * @param seed The seed.
+ */
+u64 parallel_hash(const void *data, u64 size, u64 seed);
+
+#endif // HASH_H
@@ -1,14 +1,180 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "hdf5_helpers.h"
 #include "basic_types.h"
 #include "utils.h"
 
+hid_t
+hdf5_native_type(dataset_type dtype)
+{
+    switch(dtype) {
+        case I32:
+            return H5T_NATIVE_INT;
+        case U64:
+            return H5T_NATIVE_UINT64;
+        case F32:
+            return H5T_NATIVE_FLOAT;
+        case U8:
+            return H5T_NATIVE_UINT8;
+        case U16:
+            return H5T_NATIVE_UINT16;
+        case U32:
+            return H5T_NATIVE_UINT32;
+        default:
+            return H5T_NATIVE_DOUBLE;
+    }
+}
+
+static hid_t
+create_table_fapl(void)
+{
+    hid_t fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+
+    H5AC_cache_config_t mdc_config;
+    mdc_config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+    H5Pget_mdc_config(fapl_id, &mdc_config);
+    mdc_config.set_initial_size = true;
+    mdc_config.initial_size     = HDF5_MDC_INITIAL_SIZE;
+    if(mdc_config.max_size < HDF5_MDC_INITIAL_SIZE) {
+        mdc_config.max_size = HDF5_MDC_INITIAL_SIZE;
+    }
+    H5Pset_mdc_config(fapl_id, &mdc_config);
+
+    H5Pset_alignment(fapl_id, HDF5_ALIGNMENT_THRESHOLD, HDF5_ALIGNMENT);
+
+    // Not H5F_LIBVER_LATEST as the lower bound, so that tables stay readable by the HDF5 1.8 and 1.10 libraries
+    H5Pset_libver_bounds(fapl_id, H5F_LIBVER_V18, H5F_LIBVER_LATEST);
+    return fapl_id;
+}
+
+hid_t
+open_hdf5_file(const char *filepath, const unsigned flags)
+{
+    const hid_t fapl_id = create_table_fapl();
+    const hid_t file_id = H5Fopen(filepath, flags, fapl_id);
+    H5Pclose(fapl_id);
+    return file_id;
+}
+
+hid_t
+create_hdf5_file(const char *filepath)
+{
+    const hid_t fapl_id = create_table_fapl();
+    const hid_t file_id = H5Fcreate(filepath, H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id);
+    H5Pclose(fapl_id);
+    return file_id;
+}
+
+static herr_t
+transfer_hdf5_datasets(const bool write, const int n, hid_t *dataset_ids, hid_t *mem_types, void **buffers)
+{
+#if H5_VERSION_GE(1, 14, 0)
+    hid_t spaces[n];
+    for(int i = 0; i < n; i++) {
+        spaces[i] = H5S_ALL;
+    }
+    return write ? H5Dwrite_multi(n, dataset_ids, mem_types, spaces, spaces, H5P_DEFAULT, (const void **)buffers)
+                 : H5Dread_multi(n, dataset_ids, mem_types, spaces, spaces, H5P_DEFAULT, buffers);
+#else
+    // No multi-dataset I/O before HDF5 1.14: the datasets are still opened (or created) up front
+    herr_t status = 0;
+    for(int i = 0; i < n && status >= 0; i++) {
+        status = write ? H5Dwrite(dataset_ids[i], mem_types[i], H5S_ALL, H5S_ALL, H5P_DEFAULT, buffers[i])
+                       : H5Dread(dataset_ids[i], mem_types[i], H5S_ALL, H5S_ALL, H5P_DEFAULT, buffers[i]);
+    }
+    return status;
+#endif
+}
+
+static void
+close_hdf5_datasets(const int n, const hid_t *dataset_ids)
+{
+    for(int i = 0; i < n; i++) {
+        H5Dclose(dataset_ids[i]);
+    }
+}
+
+void
+read_hdf5_datasets(hid_t file_id, const int n, hdf5_dataset_transfer *transfers)
+{
+    if(n < 1) {
+        return;
+    }
+    hid_t dataset_ids[n], mem_types[n];
+    void *buffers[n];
+    for(int i = 0; i < n; i++) {
+        const char *name = transfers[i].name;
+        dataset_ids[i]   = H5Dopen(file_id, name, H5P_DEFAULT);
+        if(dataset_ids[i] < 0) {
+            close_hdf5_datasets(i, dataset_ids);
+            error(HDF5_DATASET_NOT_FOUND, "Dataset '%s' not found.\n", name);
+        }
+
+        hid_t          dataspace_id = H5Dget_space(dataset_ids[i]);
+        const hssize_t size         = H5Sget_simple_extent_npoints(dataspace_id);
+        H5Sclose(dataspace_id);
+
+        // We don't use malloc_or_error so we can close the datasets first.
+        mem_types[i] = hdf5_native_type(transfers[i].dtype);
+        buffers[i]   = size > 0 ? malloc(size * H5Tget_size(mem_types[i])) : NULL;
+        if(!buffers[i]) {
+            close_hdf5_datasets(i + 1, dataset_ids);
+            error(OUT_OF_MEMORY, "Memory allocation failed for dataset '%s'.\n", name);
+        }
+        transfers[i].data = buffers[i];
+    }
+
+    const herr_t status = transfer_hdf5_datasets(false, n, dataset_ids, mem_types, buffers);
+    close_hdf5_datasets(n, dataset_ids);
+    if(status < 0) {
+        for(int i = 0; i < n; i++) {
+            free(buffers[i]);
+        }
+        error(HDF5_DATASET_READ_FAILED, "Problem reading %d datasets.\n", n);
+    }
+    debug("Successfully read %d datasets\n", n);
+}
+
+void
+write_hdf5_datasets(hid_t file_id, const int n, const hdf5_dataset_transfer *transfers)
+{
+    if(n < 1) {
+        return;
+    }
+    hid_t dataset_ids[n], mem_types[n];
+    void *buffers[n];
+    for(int i = 0; i < n; i++) {
+        const char *name = transfers[i].name;
+        mem_types[i]     = hdf5_native_type(transfers[i].dtype);
+        buffers[i]       = transfers[i].data;
+
+        hid_t dataspace_id = H5Screate_simple(transfers[i].ndims, transfers[i].dims, NULL);
+        if(dataspace_id < 0) {
+            close_hdf5_datasets(i, dataset_ids);
+            error(HDF5_DATASPACE_CREATE_FAILED, "Failed to create dataspace for dataset '%s'.\n", name);
+        }
+        dataset_ids[i] = H5Dcreate(file_id, name, mem_types[i], dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        H5Sclose(dataspace_id);
+        if(dataset_ids[i] < 0) {
+            close_hdf5_datasets(i, dataset_ids);
+            error(HDF5_DATASET_CREATE_FAILED, "Failed to create dataset '%s'.\n", name);
+        }
+    }
+
+    const herr_t status = transfer_hdf5_datasets(true, n, dataset_ids, mem_types, buffers);
+    close_hdf5_datasets(n, dataset_ids);
+    if(status < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Error writing %d datasets.\n", n);
+    }
+    debug("Successfully wrote %d datasets\n", n);
+}
+
 void *
 read_hdf5_dataset(hid_t file_id, dataset_type dtype, const char *dataset_name)
 {
-    const hid_t dataset_types[2] = {H5T_NATIVE_INT, H5T_NATIVE_DOUBLE};
-    const usize dtype_size[2]    = {sizeof(int), sizeof(double)};
-
-    const hid_t hdf5_dtype = dataset_types[dtype];
+    const hid_t hdf5_dtype = hdf5_native_type(dtype);
 
     // Open the dataset
     hid_t dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
@@ -36,7 +202,7 @@ read_hdf5_dataset(hid_t file_id, dataset_type dtype, const char *dataset_name)
     }
 
     // We don't use malloc_or_error so we can close the HDF5 file first.
-    void *array = malloc(total_size * dtype_size[dtype]);
+    void *array = malloc(total_size * H5Tget_size(hdf5_dtype));
     if(!array) {
         H5Sclose(dataspace_id);
         H5Dclose(dataset_id);
@@ -67,6 +233,20 @@ read_hdf5_dataset(hid_t file_id, dataset_type dtype, const char *dataset_name)
     return array;
 }
 
+hsize_t
+get_hdf5_dataset_size(hid_t file_id, const char *dataset_name)
+{
+    hid_t dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
+    if(dataset_id < 0) {
+        error(HDF5_DATASET_NOT_FOUND, "Dataset '%s' not found.\n", dataset_name);
+    }
+    hid_t          dataspace_id = H5Dget_space(dataset_id);
+    const hssize_t size         = H5Sget_simple_extent_npoints(dataspace_id);
+    H5Sclose(dataspace_id);
+    H5Dclose(dataset_id);
+    return size < 0 ? 0 : (hsize_t)size;
+}
+
 void
 write_hdf5_dataset(
     hid_t          file_id,
@@ -77,8 +257,7 @@ write_hdf5_dataset(
     const char    *dataset_name
 )
 {
-    const hid_t dataset_types[2] = {H5T_NATIVE_INT, H5T_NATIVE_DOUBLE};
-    const hid_t hdf5_dtype       = dataset_types[dtype];
+    const hid_t hdf5_dtype = hdf5_native_type(dtype);
 
     // Create the dataspace for the dataset
     hid_t dataspace_id = H5Screate_simple(ndims, dims, NULL);
@@ -114,3 +293,235 @@ write_hdf5_dataset(
     fprintf(stderr, "}\n");
 #endif
 }
+
+void
+read_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    dataset_type   dtype,
+    const char    *dataset_name,
+    const hsize_t *offset,
+    const hsize_t *count,
+    void          *data
+)
+{
+    const hid_t hdf5_dtype = hdf5_native_type(dtype);
+
+    hid_t dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
+    if(dataset_id < 0) {
+        error(HDF5_DATASET_NOT_FOUND, "Dataset '%s' not found.\n", dataset_name);
+    }
+
+    // Select the hyperslab in the file and describe the contiguous buffer in memory
+    hid_t     file_space_id = H5Dget_space(dataset_id);
+    const int ndims         = H5Sget_simple_extent_ndims(file_space_id);
+    H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+    hid_t mem_space_id = H5Screate_simple(ndims, count, NULL);
+
+    herr_t status = H5Dread(dataset_id, hdf5_dtype, mem_space_id, file_space_id, H5P_DEFAULT, data);
+
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+    H5Dclose(dataset_id);
+
+    if(status < 0) {
+        error(HDF5_DATASET_READ_FAILED, "Problem reading hyperslab of dataset '%s'.\n", dataset_name);
+    }
+}
+
+void
+write_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    hid_t          xfer_plist,
+    dataset_type   dtype,
+    int            ndims,
+    const hsize_t *dims,
+    const hsize_t *offset,
+    const hsize_t *count,
+    const void    *data,
+    const char    *dataset_name
+)
+{
+    const hid_t hdf5_dtype = hdf5_native_type(dtype);
+
+    hid_t file_space_id = H5Screate_simple(ndims, dims, NULL);
+    if(file_space_id < 0) {
+        error(HDF5_DATASPACE_CREATE_FAILED, "Failed to create dataspace for dataset '%s'.\n", dataset_name);
+    }
+
+    hid_t dataset_id =
+        H5Dcreate(file_id, dataset_name, hdf5_dtype, file_space_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if(dataset_id < 0) {
+        H5Sclose(file_space_id);
+        error(HDF5_DATASET_CREATE_FAILED, "Failed to create dataset '%s'.\n", dataset_name);
+    }
+
+    // Ranks without data still take part in collective writes, but with empty selections
+    bool has_data = true;
+    for(int i = 0; i < ndims; i++) {
+        has_data = has_data && count[i] != 0;
+    }
+    hid_t mem_space_id = H5Screate_simple(ndims, has_data ? count : dims, NULL);
+    if(has_data) {
+        H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+    }
+    else {
+        H5Sselect_none(file_space_id);
+        H5Sselect_none(mem_space_id);
+    }
+
+    herr_t status = H5Dwrite(dataset_id, hdf5_dtype, mem_space_id, file_space_id, xfer_plist, data);
+
+    H5Sclose(mem_space_id);
+    H5Dclose(dataset_id);
+    H5Sclose(file_space_id);
+
+    if(status < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Error writing hyperslab of dataset '%s'.\n", dataset_name);
+    }
+}
+
+void
+update_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    dataset_type   dtype,
+    const char    *dataset_name,
+    const hsize_t *offset,
+    const hsize_t *count,
+    const void    *data
+)
+{
+    const hid_t hdf5_dtype = hdf5_native_type(dtype);
+
+    hid_t dataset_id = H5Dopen(file_id, dataset_name, H5P_DEFAULT);
+    if(dataset_id < 0) {
+        error(HDF5_DATASET_NOT_FOUND, "Dataset '%s' not found.\n", dataset_name);
+    }
+
+    hid_t     file_space_id = H5Dget_space(dataset_id);
+    const int ndims         = H5Sget_simple_extent_ndims(file_space_id);
+    H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+    hid_t mem_space_id = H5Screate_simple(ndims, count, NULL);
+
+    herr_t status = H5Dwrite(dataset_id, hdf5_dtype, mem_space_id, file_space_id, H5P_DEFAULT, data);
+
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+    H5Dclose(dataset_id);
+
+    if(status < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Error updating hyperslab of dataset '%s'.\n", dataset_name);
+    }
+}
+
+static herr_t
+copy_hdf5_attribute(hid_t src_id, const char *name, const H5A_info_t *attr_info, void *dst)
+{
+    (void)attr_info;
+    const hid_t dst_id = *(hid_t *)dst;
+
+    hid_t attr_id  = H5Aopen(src_id, name, H5P_DEFAULT);
+    hid_t type_id  = H5Aget_type(attr_id);
+    hid_t space_id = H5Aget_space(attr_id);
+
+    const hssize_t npoints = H5Sget_simple_extent_npoints(space_id);
+    void          *buffer  = malloc_or_error((npoints > 0 ? npoints : 1) * H5Tget_size(type_id));
+
+    herr_t status = H5Aread(attr_id, type_id, buffer);
+    if(status >= 0) {
+        hid_t copy_id = H5Acreate(dst_id, name, type_id, space_id, H5P_DEFAULT, H5P_DEFAULT);
+        status        = copy_id < 0 ? -1 : H5Awrite(copy_id, type_id, buffer);
+        H5Aclose(copy_id);
+
+        // Variable length data (e.g., strings) is allocated by the library
+        if(H5Tis_variable_str(type_id) > 0 || H5Tdetect_class(type_id, H5T_VLEN) > 0) {
+            H5Dvlen_reclaim(type_id, space_id, H5P_DEFAULT, buffer);
+        }
+    }
+
+    free(buffer);
+    H5Sclose(space_id);
+    H5Tclose(type_id);
+    H5Aclose(attr_id);
+
+    if(status < 0) {
+        warn("Could not copy attribute '%s'\n", name);
+    }
+    return 0;
+}
+
+void
+copy_hdf5_attributes(hid_t src_id, hid_t dst_id)
+{
+    H5Aiterate2(src_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, copy_hdf5_attribute, &dst_id);
+}
+
+void
+write_hdf5_attribute(hid_t obj_id, dataset_type dtype, const char *name, const void *value)
+{
+    hid_t space_id = H5Screate(H5S_SCALAR);
+    hid_t attr_id  = H5Acreate(obj_id, name, hdf5_native_type(dtype), space_id, H5P_DEFAULT, H5P_DEFAULT);
+    if(attr_id < 0 || H5Awrite(attr_id, hdf5_native_type(dtype), value) < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Failed to write attribute '%s'.\n", name);
+    }
+    H5Aclose(attr_id);
+    H5Sclose(space_id);
+}
+
+bool
+read_hdf5_attribute(hid_t obj_id, dataset_type dtype, const char *name, void *value)
+{
+    if(H5Aexists(obj_id, name) <= 0) {
+        return false;
+    }
+    hid_t  attr_id = H5Aopen(obj_id, name, H5P_DEFAULT);
+    herr_t status  = H5Aread(attr_id, hdf5_native_type(dtype), value);
+    H5Aclose(attr_id);
+    if(status < 0) {
+        error(HDF5_DATASET_READ_FAILED, "Failed to read attribute '%s'.\n", name);
+    }
+    return true;
+}
+
+void
+write_hdf5_string_attribute(hid_t obj_id, const char *name, const char *value)
+{
+    hid_t type_id = H5Tcopy(H5T_C_S1);
+    H5Tset_size(type_id, strlen(value) + 1);
+    H5Tset_strpad(type_id, H5T_STR_NULLTERM);
+
+    hid_t space_id = H5Screate(H5S_SCALAR);
+    hid_t attr_id  = H5Acreate(obj_id, name, type_id, space_id, H5P_DEFAULT, H5P_DEFAULT);
+    if(attr_id < 0 || H5Awrite(attr_id, type_id, value) < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Failed to write attribute '%s'.\n", name);
+    }
+    H5Aclose(attr_id);
+    H5Sclose(space_id);
+    H5Tclose(type_id);
+}
+
+bool
+read_hdf5_string_attribute(hid_t obj_id, const char *name, char *value, const usize size)
+{
+    if(H5Aexists(obj_id, name) <= 0) {
+        return false;
+    }
+    hid_t attr_id   = H5Aopen(obj_id, name, H5P_DEFAULT);
+    hid_t file_type = H5Aget_type(attr_id);
+    if(H5Tget_class(file_type) != H5T_STRING || H5Tis_variable_str(file_type) > 0 || H5Tget_size(file_type) >= size) {
+        error(HDF5_DATASET_READ_FAILED, "Attribute '%s' is not a string of fewer than %zu bytes.\n", name, size);
+    }
+
+    // Read into a buffer one byte larger than the string so that it is always null terminated
+    hid_t mem_type = H5Tcopy(H5T_C_S1);
+    H5Tset_size(mem_type, H5Tget_size(file_type) + 1);
+    H5Tset_strpad(mem_type, H5T_STR_NULLTERM);
+    herr_t status = H5Aread(attr_id, mem_type, value);
+
+    H5Tclose(mem_type);
+    H5Tclose(file_type);
+    H5Aclose(attr_id);
+    if(status < 0) {
+        error(HDF5_DATASET_READ_FAILED, "Failed to read attribute '%s'.\n", name);
+    }
+    return true;
+}
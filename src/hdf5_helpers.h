@@ -9,6 +9,9 @@
 #define HDF5_HELPERS_H
 
 #include <hdf5.h>
+#include <stdbool.h>
+
+#include "basic_types.h"
 
 /**
  * @brief Enumeration for supported HDF5 dataset types.
@@ -16,14 +19,62 @@
 typedef enum
 {
     I32,
-    F64
+    F64,
+    U64,
+    F32,
+    U8,
+    U16,
+    U32
 } dataset_type;
 
+#define HDF5_MDC_INITIAL_SIZE    (8 << 20) ///< Initial size of the metadata cache of table files.
+#define HDF5_ALIGNMENT_THRESHOLD (1 << 20) ///< Objects at least this large are aligned to HDF5_ALIGNMENT.
+#define HDF5_ALIGNMENT           (1 << 20) ///< Alignment of large objects, e.g., a parallel file system stripe.
+
+/**
+ * @brief A dataset read or written by read_hdf5_datasets or write_hdf5_datasets.
+ */
+typedef struct
+{
+    const char    *name;  ///< Name of the dataset.
+    dataset_type   dtype; ///< Type of the data in memory (and, for writes, in the file).
+    int            ndims; ///< Number of dimensions (writes only).
+    const hsize_t *dims;  ///< Size of each dimension (writes only).
+    void          *data;  ///< Data to write, or the data read (allocated by read_hdf5_datasets).
+} hdf5_dataset_transfer;
+
+/**
+ * @brief Returns the native HDF5 type corresponding to a dataset type.
+ */
+hid_t hdf5_native_type(dataset_type dtype);
+
+/**
+ * @brief Opens an HDF5 file with file access properties tuned for EOS tables.
+ *
+ * The metadata cache starts at HDF5_MDC_INITIAL_SIZE, large objects are aligned to HDF5_ALIGNMENT, and new objects
+ * use the HDF5 1.8 (or later) file format, whose compact link storage needs fewer metadata operations.
+ *
+ * @param filepath Path to the file.
+ * @param flags Access flags (e.g., H5F_ACC_RDONLY).
+ *
+ * @return The file identifier, or a negative value on failure.
+ */
+hid_t open_hdf5_file(const char *filepath, unsigned flags);
+
+/**
+ * @brief Creates (or truncates) an HDF5 file with the file access properties of open_hdf5_file.
+ *
+ * @param filepath Path to the file.
+ *
+ * @return The file identifier, or a negative value on failure.
+ */
+hid_t create_hdf5_file(const char *filepath);
+
 /**
  * @brief Reads an HDF5 dataset from a file.
  *
  * @param file_id The HDF5 file identifier.
- * @param dtype The data type of the dataset (I32 or F64).
+ * @param dtype The data type of the dataset (e.g., I32 or F64).
  * @param dataset_name The name of the dataset to read.
  *
  * @return A pointer to the allocated memory containing the dataset data.
@@ -31,11 +82,41 @@ typedef enum
  */
 void *read_hdf5_dataset(hid_t file_id, dataset_type dtype, const char *dataset_name);
 
+/**
+ * @brief Reads several HDF5 datasets, issuing all transfers at once.
+ *
+ * All datasets are opened first and then read with a single H5Dread_multi call (HDF5 1.14 or later) or, with older
+ * versions of HDF5, one H5Dread per dataset.
+ *
+ * @param file_id The HDF5 file identifier.
+ * @param n Number of datasets.
+ * @param transfers The name and type of each dataset. On return, data points to the data read, which the caller must
+ *                  free.
+ */
+void read_hdf5_datasets(hid_t file_id, int n, hdf5_dataset_transfer *transfers);
+
+/**
+ * @brief Creates and writes several HDF5 datasets, issuing all transfers at once (see read_hdf5_datasets).
+ *
+ * @param file_id The HDF5 file identifier.
+ * @param n Number of datasets.
+ * @param transfers The name, type, dimensions, and data of each dataset.
+ */
+void write_hdf5_datasets(hid_t file_id, int n, const hdf5_dataset_transfer *transfers);
+
+/**
+ * @brief Returns the total number of elements in an HDF5 dataset.
+ *
+ * @param file_id The HDF5 file (or group) identifier.
+ * @param dataset_name The name of the dataset.
+ */
+hsize_t get_hdf5_dataset_size(hid_t file_id, const char *dataset_name);
+
 /**
  * @brief Writes data to an HDF5 dataset in a file.
  *
  * @param file_id The HDF5 file identifier.
- * @param dtype The data type of the dataset (I32 or F64).
+ * @param dtype The data type of the dataset (e.g., I32 or F64).
  * @param ndims The number of dimensions of the dataset.
  * @param dims An array containing the size of each dimension.
  * @param data A pointer to the data to be written.
@@ -53,4 +134,121 @@ void write_hdf5_dataset(
     const char    *dataset_name
 );
 
+/**
+ * @brief Reads a hyperslab of an HDF5 dataset into a caller-owned buffer.
+ *
+ * @param file_id The HDF5 file identifier.
+ * @param dtype The data type of the dataset (e.g., I32 or F64).
+ * @param dataset_name The name of the dataset to read.
+ * @param offset The offset of the hyperslab in each dimension of the dataset.
+ * @param count The size of the hyperslab in each dimension of the dataset.
+ * @param data A pointer to a contiguous buffer large enough to hold the hyperslab.
+ */
+void read_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    dataset_type   dtype,
+    const char    *dataset_name,
+    const hsize_t *offset,
+    const hsize_t *count,
+    void          *data
+);
+
+/**
+ * @brief Creates an HDF5 dataset and writes a hyperslab of it.
+ *
+ * This is meant for parallel HDF5 files, where all ranks create the dataset collectively and each one writes its own
+ * hyperslab. Ranks with nothing to write pass a count containing a zero.
+ *
+ * @param file_id The HDF5 file identifier.
+ * @param xfer_plist The dataset transfer property list (e.g., collective MPI-IO).
+ * @param dtype The data type of the dataset (e.g., I32 or F64).
+ * @param ndims The number of dimensions of the dataset.
+ * @param dims An array containing the size of each dimension of the full dataset.
+ * @param offset The offset of the hyperslab in each dimension.
+ * @param count The size of the hyperslab in each dimension.
+ * @param data A pointer to the contiguous hyperslab data to be written.
+ * @param dataset_name The name of the dataset to write.
+ */
+void write_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    hid_t          xfer_plist,
+    dataset_type   dtype,
+    int            ndims,
+    const hsize_t *dims,
+    const hsize_t *offset,
+    const hsize_t *count,
+    const void    *data,
+    const char    *dataset_name
+);
+
+/**
+ * @brief Overwrites a hyperslab of an existing HDF5 dataset.
+ *
+ * @param file_id The HDF5 file identifier (opened for writing).
+ * @param dtype The data type of the data in memory (e.g., I32 or F64).
+ * @param dataset_name The name of the dataset to update.
+ * @param offset The offset of the hyperslab in each dimension of the dataset.
+ * @param count The size of the hyperslab in each dimension of the dataset.
+ * @param data A pointer to the contiguous hyperslab data to be written.
+ */
+void update_hdf5_dataset_hyperslab(
+    hid_t          file_id,
+    dataset_type   dtype,
+    const char    *dataset_name,
+    const hsize_t *offset,
+    const hsize_t *count,
+    const void    *data
+);
+
+/**
+ * @brief Copies all attributes of an HDF5 object (e.g., the root group) to another object.
+ *
+ * @param src_id The identifier of the object to copy the attributes from.
+ * @param dst_id The identifier of the object to copy the attributes to.
+ */
+void copy_hdf5_attributes(hid_t src_id, hid_t dst_id);
+
+/**
+ * @brief Writes a scalar attribute to an HDF5 object.
+ *
+ * @param obj_id The identifier of the object (e.g., a file or dataset).
+ * @param dtype The type of the attribute (e.g., I32 or F64).
+ * @param name The name of the attribute.
+ * @param value Pointer to the value to write.
+ */
+void write_hdf5_attribute(hid_t obj_id, dataset_type dtype, const char *name, const void *value);
+
+/**
+ * @brief Reads a scalar attribute of an HDF5 object.
+ *
+ * @param obj_id The identifier of the object (e.g., a file or dataset).
+ * @param dtype The type of the attribute (e.g., I32 or F64).
+ * @param name The name of the attribute.
+ * @param value Pointer to where the value is stored.
+ *
+ * @return false if the object has no attribute with that name, true otherwise.
+ */
+bool read_hdf5_attribute(hid_t obj_id, dataset_type dtype, const char *name, void *value);
+
+/**
+ * @brief Writes a fixed-length string attribute to an HDF5 object.
+ *
+ * @param obj_id The identifier of the object (e.g., a file or dataset).
+ * @param name The name of the attribute.
+ * @param value The null-terminated string to write.
+ */
+void write_hdf5_string_attribute(hid_t obj_id, const char *name, const char *value);
+
+/**
+ * @brief Reads a fixed-length string attribute of an HDF5 object.
+ *
+ * @param obj_id The identifier of the object (e.g., a file or dataset).
+ * @param name The name of the attribute.
+ * @param value Buffer where the null-terminated string is stored.
+ * @param size Size of the buffer in bytes.
+ *
+ * @return false if the object has no attribute with that name, true otherwise.
+ */
+bool read_hdf5_string_attribute(hid_t obj_id, const char *name, char *value, usize size);
+
 #endif // HDF5_HELPERS_H
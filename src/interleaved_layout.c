@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interleaved_layout.h"
+#include "utils.h"
+
+interleaved_layout
+make_interleaved_layout(
+    const stellar_collapse_eos          *table,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const bool                           pad,
+    const int                            tile
+)
+{
+    if(n_qtys < 1 || n_qtys > number_of_eos_quantities) {
+        error(INVALID_ARGUMENT, "Interleaved layout needs between 1 and %d quantities\n", number_of_eos_quantities);
+    }
+    if(tile < 1) {
+        error(INVALID_ARGUMENT, "Tile size must be positive, but got %d\n", tile);
+    }
+
+    interleaved_layout layout = {0};
+    layout.n_qtys             = n_qtys;
+    memcpy(layout.qtys, qtys, sizeof(stellar_collapse_eos_quantity) * n_qtys);
+
+    const i32 per_line = CACHE_LINE_SIZE / sizeof(f64);
+    layout.stride      = pad ? (n_qtys + per_line - 1) / per_line * per_line : n_qtys;
+    layout.tile        = tile;
+    layout.n_tiles[0]  = (table->n_rho + tile - 1) / tile;
+    layout.n_tiles[1]  = (table->n_temperature + tile - 1) / tile;
+    layout.n_tiles[2]  = (table->n_ye + tile - 1) / tile;
+
+    return layout;
+}
+
+u64
+interleaved_layout_size(const interleaved_layout *layout)
+{
+    const u64 tile_points = (u64)layout->tile * layout->tile * layout->tile;
+    return (u64)layout->n_tiles[0] * layout->n_tiles[1] * layout->n_tiles[2] * tile_points * layout->stride;
+}
+
+void
+interleave_table(const stellar_collapse_eos *table, const interleaved_layout *layout, f64 *records)
+{
+    // Padding and points past the edges of the grid
+    memset(records, 0, sizeof(f64) * interleaved_layout_size(layout));
+
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2)
+#endif
+    for(i32 k = 0; k < table->n_ye; k++) {
+        for(i32 j = 0; j < table->n_temperature; j++) {
+            for(i32 i = 0; i < table->n_rho; i++) {
+                f64      *record = records + interleaved_record_offset(layout, i, j, k);
+                const u64 index  = i + (u64)table->n_rho * (j + (u64)table->n_temperature * k);
+                for(i32 q = 0; q < layout->n_qtys; q++) {
+                    record[q] = table->data[layout->qtys[q]][index];
+                }
+            }
+        }
+    }
+}
+
+void
+deinterleave_table(stellar_collapse_eos *table, const interleaved_layout *layout, const f64 *records)
+{
+    const u64 size = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    for(i32 q = 0; q < layout->n_qtys; q++) {
+        if(!table->data[layout->qtys[q]]) {
+            table->data[layout->qtys[q]] = malloc_or_error(sizeof(f64) * size);
+        }
+    }
+
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2)
+#endif
+    for(i32 k = 0; k < table->n_ye; k++) {
+        for(i32 j = 0; j < table->n_temperature; j++) {
+            for(i32 i = 0; i < table->n_rho; i++) {
+                const f64 *record = records + interleaved_record_offset(layout, i, j, k);
+                const u64  index  = i + (u64)table->n_rho * (j + (u64)table->n_temperature * k);
+                for(i32 q = 0; q < layout->n_qtys; q++) {
+                    table->data[layout->qtys[q]][index] = record[q];
+                }
+            }
+        }
+    }
+}
+
+int
+parse_quantity_list(const char *list, stellar_collapse_eos_quantity *qtys)
+{
+    bool seen[number_of_eos_quantities] = {false};
+    int  n_qtys                         = 0;
+
+    while(*list != '\0') {
+        const char *comma = strchr(list, ',');
+        const usize len   = comma ? (usize)(comma - list) : strlen(list);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%.*s", (int)len, list);
+        const stellar_collapse_eos_quantity qty = stellar_collapse_qty_from_str(name);
+        if(qty == number_of_eos_quantities) {
+            error(INVALID_ARGUMENT, "Unknown quantity '%s'\n", name);
+        }
+        if(seen[qty]) {
+            error(INVALID_ARGUMENT, "Quantity '%s' listed more than once\n", name);
+        }
+        seen[qty]      = true;
+        qtys[n_qtys++] = qty;
+
+        list += comma ? len + 1 : len;
+    }
+
+    return n_qtys;
+}
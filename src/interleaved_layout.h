@@ -0,0 +1,122 @@
+/**
+ * @file interleaved_layout.h
+ * @author Leo Werneck
+ *
+ * @brief Array-of-structs table layout where all selected quantities of a grid point are stored contiguously.
+ *
+ * Interpolation reads every quantity at the same corners of a cell, so storing each grid point as one record turns
+ * one cache line fetch per quantity into one per corner. Records may be padded to a whole number of cache lines, and
+ * grouped in cubic tiles of points (rho fastest, then T, then Ye) so that all corners of a cell usually share a tile.
+ * Tiles at the upper edges of the grid are padded with zeros.
+ */
+#ifndef INTERLEAVED_LAYOUT_H
+#define INTERLEAVED_LAYOUT_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "stellar_collapse_eos.h"
+
+#define CACHE_LINE_SIZE (64)
+
+/**
+ * @brief Describes how the records of an interleaved table are laid out in memory.
+ */
+typedef struct
+{
+    i32                           n_qtys;                         ///< Number of quantities in each record.
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities]; ///< Quantities in record order.
+    i32                           stride;                         ///< Record size in f64 values (including padding).
+    i32                           tile;                           ///< Tile edge in points (1 means no tiling).
+    i32                           n_tiles[3];                     ///< Number of tiles along rho, T, and Ye.
+} interleaved_layout;
+
+/**
+ * @brief Creates the layout of a table.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure (only the dimensions are used).
+ * @param qtys Quantities to store in each record, in order.
+ * @param n_qtys Number of quantities.
+ * @param pad If true, records are padded to a whole number of cache lines.
+ * @param tile Tile edge in points (1 means no tiling).
+ */
+interleaved_layout make_interleaved_layout(
+    const stellar_collapse_eos          *table,
+    const stellar_collapse_eos_quantity *qtys,
+    int                                  n_qtys,
+    bool                                 pad,
+    int                                  tile
+);
+
+/**
+ * @brief Returns the total number of f64 values needed to store the table with this layout.
+ */
+u64 interleaved_layout_size(const interleaved_layout *layout);
+
+/**
+ * @brief Returns the offset (in f64 values) of the record of a grid point.
+ */
+static inline u64
+interleaved_record_offset(const interleaved_layout *layout, const i32 i_rho, const i32 i_T, const i32 i_ye)
+{
+    const i32 b     = layout->tile;
+    const u64 tile  = ((u64)(i_ye / b) * layout->n_tiles[1] + i_T / b) * layout->n_tiles[0] + i_rho / b;
+    const u64 point = ((u64)(i_ye % b) * b + i_T % b) * b + i_rho % b;
+    return (tile * b * b * b + point) * layout->stride;
+}
+
+/**
+ * @brief Copies the selected quantities of a table into records.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure.
+ * @param layout The layout of the records.
+ * @param records Output buffer with interleaved_layout_size(layout) values.
+ */
+void interleave_table(const stellar_collapse_eos *table, const interleaved_layout *layout, f64 *records);
+
+/**
+ * @brief Copies records back into the planar arrays of a table, allocating any that are missing.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure (dimensions must be set).
+ * @param layout The layout of the records.
+ * @param records Buffer with interleaved_layout_size(layout) values.
+ */
+void deinterleave_table(stellar_collapse_eos *table, const interleaved_layout *layout, const f64 *records);
+
+/**
+ * @brief Parses a comma separated list of quantity names (e.g., "logpress,logenergy,cs2").
+ *
+ * @param list The list to parse.
+ * @param qtys Output array with room for number_of_eos_quantities entries.
+ *
+ * @return The number of quantities in the list. Unknown or repeated names are an error.
+ */
+int parse_quantity_list(const char *list, stellar_collapse_eos_quantity *qtys);
+
+/**
+ * @brief Writes a stellar collapse EOS table with the selected quantities interleaved.
+ *
+ * The records are stored in a 1D dataset named "interleaved" whose attributes ("quantities", "record_size", and
+ * "tile_size") describe the layout, and the root group gets the attribute layout = "interleaved". The remaining
+ * quantities are written as usual, so read_stellar_collapse_eos_table reads either layout.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to write.
+ * @param layout The layout of the records.
+ * @param filepath Path to the output EOS table file (HDF5 format).
+ */
+void write_stellar_collapse_eos_table_interleaved(
+    const stellar_collapse_eos *table,
+    const interleaved_layout   *layout,
+    const char                 *filepath
+);
+
+/**
+ * @brief Returns whether an HDF5 file holds a table with interleaved quantities.
+ *
+ * Files that cannot be opened as HDF5 are reported as not interleaved, so that reading them reports the error.
+ *
+ * @param filepath Path to the file.
+ */
+bool is_interleaved_table_file(const char *filepath);
+
+#endif // INTERLEAVED_LAYOUT_H
@@ -0,0 +1,152 @@
+// Needed for posix_memalign(3)
+#define _POSIX_C_SOURCE 200112L
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include "eos_lookup.h"
+#include "lookup_benchmark.h"
+#include "utils.h"
+
+#define BENCHMARK_REPEATS (3)
+
+static f64
+wall_time(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return (f64)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static f64 *
+aligned_f64_array(const u64 size)
+{
+    void *ptr = NULL;
+    if(posix_memalign(&ptr, CACHE_LINE_SIZE, sizeof(f64) * (size ? size : 1))) {
+        error(OUT_OF_MEMORY, "Could not allocate %" PRIu64 " aligned values.\n", size);
+    }
+    return ptr;
+}
+
+// SplitMix64, so that the query points are the same on every run
+static f64
+uniform_random(u64 *state)
+{
+    u64 z = (*state += 0x9E3779B97F4A7C15ULL);
+    z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z     = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z     = z ^ (z >> 31);
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static f64
+time_lookups(const eos_lookup *lookup, const u64 n, const f64 *lr, const f64 *lt, const f64 *ye, f64 *out)
+{
+    // Best of a few runs; the first one also warms up the caches and the thread pool
+    f64 best = INFINITY;
+    for(int r = 0; r < BENCHMARK_REPEATS; r++) {
+        const f64 start = wall_time();
+        eos_lookup_batch(lookup, n, lr, lt, ye, out);
+        const f64 elapsed = wall_time() - start;
+        best              = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+void
+benchmark_table_lookups(const options_t *opts)
+{
+    stellar_collapse_eos *table = read_stellar_collapse_eos_table(opts->input_table_path);
+    info("Successfully read table from file '%s'\n", opts->input_table_path);
+
+    const u64 n      = opts->n_benchmark_lookups;
+    const int n_qtys = opts->n_layout_qtys;
+    f64      *lr     = aligned_f64_array(n);
+    f64      *lt     = aligned_f64_array(n);
+    f64      *ye     = aligned_f64_array(n);
+
+    u64 state = 0x5EED;
+    for(u64 p = 0; p < n; p++) {
+        lr[p] = table->log10_rho[0] + uniform_random(&state) * (table->log10_rho[table->n_rho - 1] - table->log10_rho[0]);
+        lt[p] = table->log10_temperature[0]
+              + uniform_random(&state) * (table->log10_temperature[table->n_temperature - 1] - table->log10_temperature[0]);
+        ye[p] = table->ye[0] + uniform_random(&state) * (table->ye[table->n_ye - 1] - table->ye[0]);
+    }
+
+    const interleaved_layout layout =
+        make_interleaved_layout(table, opts->layout_qtys, n_qtys, opts->layout_pad, opts->layout_tile);
+    f64 *records = aligned_f64_array(interleaved_layout_size(&layout));
+    interleave_table(table, &layout, records);
+
+    eos_lookup planar      = make_eos_lookup(table, opts->layout_qtys, n_qtys, NULL, NULL);
+    eos_lookup interleaved = make_eos_lookup(table, opts->layout_qtys, n_qtys, &layout, records);
+
+    f64 *planar_out      = aligned_f64_array(n * n_qtys);
+    f64 *interleaved_out = aligned_f64_array(n * n_qtys);
+
+    info("Benchmarking %" PRIu64 " lookups of %d quantities\n", n, n_qtys);
+    const f64 planar_time      = time_lookups(&planar, n, lr, lt, ye, planar_out);
+    const f64 interleaved_time = time_lookups(&interleaved, n, lr, lt, ye, interleaved_out);
+    info("  planar      : %.3e lookups/s (%.3f s)\n", n / planar_time, planar_time);
+    info("  interleaved : %.3e lookups/s (%.3f s)\n", n / interleaved_time, interleaved_time);
+    info("  speedup     : %.2fx\n", planar_time / interleaved_time);
+
+    u64 mismatches = 0;
+    for(u64 i = 0; i < n * n_qtys; i++) {
+        mismatches += planar_out[i] != interleaved_out[i] && !(isnan(planar_out[i]) && isnan(interleaved_out[i]));
+    }
+    if(mismatches) {
+        warn("Planar and interleaved lookups differ in %" PRIu64 " of %" PRIu64 " values\n", mismatches, n * n_qtys);
+    }
+
+    // Lookups at grid points must give back the tabulated values (errors are relative to the largest magnitude)
+    const u64 size = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    f64       scale[number_of_eos_quantities];
+    for(int q = 0; q < n_qtys; q++) {
+        scale[q] = 0;
+        for(u64 i = 0; i < size; i++) {
+            scale[q] = fmax(scale[q], fabs(table->data[opts->layout_qtys[q]][i]));
+        }
+    }
+
+    const u64 n_nodes   = n < 100000 ? n : 100000;
+    u64      *nodes     = malloc_or_error(sizeof(u64) * (n_nodes ? n_nodes : 1));
+    f64       max_error = 0;
+    for(u64 p = 0; p < n_nodes; p++) {
+        const i32 i = (i32)(uniform_random(&state) * table->n_rho);
+        const i32 j = (i32)(uniform_random(&state) * table->n_temperature);
+        const i32 k = (i32)(uniform_random(&state) * table->n_ye);
+        lr[p]       = table->log10_rho[i];
+        lt[p]       = table->log10_temperature[j];
+        ye[p]       = table->ye[k];
+        nodes[p]    = i + (u64)table->n_rho * (j + (u64)table->n_temperature * k);
+    }
+    eos_lookup_batch(&planar, n_nodes, lr, lt, ye, planar_out);
+    for(u64 p = 0; p < n_nodes; p++) {
+        for(int q = 0; q < n_qtys; q++) {
+            const f64 expected = table->data[opts->layout_qtys[q]][nodes[p]];
+            const f64 err      = fabs(planar_out[p * n_qtys + q] - expected) / (scale[q] > 0 ? scale[q] : 1);
+            max_error          = err > max_error ? err : max_error;
+        }
+    }
+    free(nodes);
+    info("  max error at grid points (relative to the largest value): %.3e\n", max_error);
+
+    free(lr);
+    free(lt);
+    free(ye);
+    free_eos_lookup(&planar);
+    free_eos_lookup(&interleaved);
+    free(records);
+    free(planar_out);
+    free(interleaved_out);
+    free_stellar_collapse_eos_table(table);
+}
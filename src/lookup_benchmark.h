@@ -0,0 +1,22 @@
+/**
+ * @file lookup_benchmark.h
+ * @author Leo Werneck
+ *
+ * @brief Measures how fast a table can be interpolated with the planar and interleaved layouts.
+ */
+#ifndef LOOKUP_BENCHMARK_H
+#define LOOKUP_BENCHMARK_H
+
+#include "options.h"
+
+/**
+ * @brief Interpolates a table at random points with both layouts and reports lookups per second.
+ *
+ * The interleaved layout uses the layout options (quantities, padding, and tile size). Both layouts must give the
+ * same results, and interpolating at grid points must give back the tabulated values; any mismatch is reported.
+ *
+ * @param opts Pointer to the options (input table, number of lookups, and layout options).
+ */
+void benchmark_table_lookups(const options_t *opts);
+
+#endif // LOOKUP_BENCHMARK_H
@@ -2,21 +2,77 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "median_filter.h"
+#include "calibrate.h"
+#include "cleaner.h"
+#include "lookup_benchmark.h"
 #include "options.h"
-#include "stellar_collapse_eos.h"
+#include "patch.h"
+#include "scan.h"
 #include "utils.h"
 
+#ifdef USE_MPI
+#    include <mpi.h>
+
+#    include "mpi_cleaner.h"
+#endif
+
 int
 main(int argc, char **argv)
 {
+#ifdef USE_MPI
+    MPI_Init(&argc, &argv);
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if(rank != 0) {
+        set_info_messages_enabled(false);
+    }
+#endif
 
-    if(argc < 2 || (argc % 2 != 0)) {
+    if(argc < 2) {
         info(
-            "Usage: %s [-o <outfile>] [-s <smoothing>] [-d <derivs>] <input>\n"
-            "  -o, --output      Output file name. Default <input>_clean.h5\n"
-            "  -s, --smoothing   derivs (default), hydro, all, none (for debugging)\n"
-            "  -d, --derivs      smooth (default), recompute, none (for debugging)\n",
+            "Usage: %s [-o <outfile>] [-s <smoothing>] [-d <derivs>] <input> [<input> ...]\n"
+            "  -o, --output          Output file name. Default <input>_clean.h5\n"
+            "  -O, --output-dir      Output directory for batch mode. Outputs are named <input>_clean.h5\n"
+            "      --no-overlap      Batch mode: do not overlap reading and writing with cleaning\n"
+            "      --copy-through    Copy unmodified datasets (and any extra objects) from the input\n"
+            "      --in-place        Update only the modified parts of the input file (no output file)\n"
+            "      --output-format   hdf5 (default) or binary (page-aligned arrays that can be mapped into memory;\n"
+            "                        binary tables are also accepted as input)\n"
+            "      --layout          Output layout: planar (default) or interleaved (one record per grid point)\n"
+            "      --layout-qtys     Comma separated quantities to interleave. Default all\n"
+            "      --layout-pad      Pad interleaved records to a whole number of cache lines\n"
+            "      --layout-tile     Store interleaved records in cubic tiles of this many points per edge\n"
+            "      --precision       <qty>=f32|quant[:abs=<bound>|:rel=<bound>] stores a quantity with reduced precision\n"
+            "                        (repeatable; e.g., --precision Xa=quant:abs=1e-6 --precision cs2=f32:rel=1e-6)\n"
+            "      --decimate        Remove grid lines reproduced by interpolation within this tolerance (relative to the\n"
+            "                        range of each quantity)\n"
+            "      --decimate-qtys   Comma separated quantities the decimation must reproduce. Default all\n"
+            "      --benchmark       Interpolate <input> at this many random points with the planar and interleaved\n"
+            "                        layouts (see --layout-*) and report lookups per second instead of cleaning\n"
+            "      --rho-range       <min>:<max> Only clean densities in this range (g/cm^3)\n"
+            "      --temp-range      <min>:<max> Only clean temperatures in this range (MeV)\n"
+            "      --ye-range        <min>:<max> Only clean electron fractions in this range\n"
+            "      --scan            Estimate the fraction of outliers of each quantity from this many sampled points and\n"
+            "                        check for NaNs, infinities, and non-monotonic axes, instead of cleaning\n"
+            "      --median-f32      Find the median of the filter window in single precision (results are unchanged;\n"
+            "                        outliers and points near the threshold are tested again in double precision)\n"
+            "      --calibrate       Time the thread counts, tile sizes, and schedules of the filter and of the cs2\n"
+            "                        recomputation on a slab of <input>, and store the fastest ones in the profile of\n"
+            "                        this machine, which later runs load automatically (nothing else is written)\n"
+            "      --profile-dir     Directory of the execution profiles. Default ~/" PROFILE_DIR_DEFAULT "\n"
+            "      --consistency     Count the points where pressure decreases with density, dedt is negative, gamma\n"
+            "                        disagrees with cs2, or entropy decreases with temperature, after cleaning\n"
+            "      --consistency-mask\n"
+            "                        Also write a mask of the conditions violated at each point to this file\n"
+            "      --cache-dir       Reuse results (and filtered quantities) of earlier runs stored in this directory\n"
+            "      --checkpoint      Save each filtered quantity to this file as soon as it is done\n"
+            "      --resume          Skip the quantities already saved by an interrupted run with --checkpoint\n"
+            "      --patch           Also write a patch with only the points changed by the cleaner\n"
+            "      --apply-patch     Apply a patch written by --patch to <input> instead of cleaning it\n"
+            "      --log-level       error, warning, info, debug (default; debug messages only in debug builds)\n"
+            "  -s, --smoothing       derivs (default), hydro, all, none (for debugging)\n"
+            "  -d, --derivs          smooth (default), recompute, none (for debugging)\n"
+            "Inputs may be glob patterns (e.g., 'tables/*.h5'). Multiple inputs select batch mode.\n",
             argv[0]
         );
         return 0;
@@ -26,57 +82,68 @@ main(int argc, char **argv)
         error(UNSUPPORTED_FEATURE, "Recompute derivatives it not yet supported.\n");
     }
 
-    stellar_collapse_eos *table = read_stellar_collapse_eos_table(opts.input_table_path);
-    info("Successfully read table from file '%s'\n", opts.input_table_path);
-
-    if(opts.smoother == SMOOTH_ALL) {
-        info("Applying median filter to *all* table quantities:\n");
-        for(int qty = 0; qty < number_of_eos_quantities; qty++) {
-            if(opts.derivs != DERIVS_SMOOTH && (qty == eos_dpdrhoe || qty == eos_dpderho || qty == eos_dedt)) {
-                continue;
-            }
-            info("  %s...\n", stellar_collapse_qty_to_str(qty));
-            apply_median_filter(table, qty);
-        }
-    }
-    else if(opts.smoother == SMOOTH_HYDRO_ONLY) {
-        info("Applying median filter to hydro quantities only (not derivatives)\n");
-        for(int qty = 0; qty < number_of_eos_quantities; qty++) {
-            if(qty == eos_dpdrhoe || qty == eos_dpderho || qty == eos_dedt) {
-                continue;
-            }
-            info("  %s...\n", stellar_collapse_qty_to_str(qty));
-            apply_median_filter(table, qty);
-        }
-    }
-    else if(opts.smoother == SMOOTH_DERIVS_ONLY) {
-        info("Applying median filter to derivatives only\n");
-
-        info("  dpdrhoe...\n");
-        apply_median_filter(table, eos_dpdrhoe);
-
-        info("  dpderho...\n");
-        apply_median_filter(table, eos_dpderho);
-
-        info("  dedt...\n");
-        apply_median_filter(table, eos_dedt);
+#ifdef USE_MPI
+    if(opts.patch_path[0] != '\0' || opts.apply_patch_path[0] != '\0') {
+        error(UNSUPPORTED_FEATURE, "Patches are not supported in the MPI build.\n");
+    }
+    if(opts.layout != LAYOUT_PLANAR || opts.n_benchmark_lookups || opts.reduce_precision
+       || opts.decimate_tolerance > 0 || opts.n_scan_samples) {
+        error(
+            UNSUPPORTED_FEATURE,
+            "Alternative output formats, benchmarks, and scans are not supported in the MPI build.\n"
+        );
+    }
+    if(opts.cache_dir[0] != '\0') {
+        error(UNSUPPORTED_FEATURE, "The result cache is not supported in the MPI build.\n");
+    }
+    if(opts.checkpoint_path[0] != '\0') {
+        error(UNSUPPORTED_FEATURE, "Checkpoints are not supported in the MPI build.\n");
+    }
+    if(opts.use_roi) {
+        error(UNSUPPORTED_FEATURE, "Regions of interest are not supported in the MPI build.\n");
+    }
+    if(opts.output_format != FORMAT_HDF5) {
+        error(UNSUPPORTED_FEATURE, "Binary tables are not supported in the MPI build.\n");
+    }
+    if(opts.check_consistency) {
+        error(UNSUPPORTED_FEATURE, "Consistency checks are not supported in the MPI build.\n");
+    }
+    if(opts.calibrate) {
+        error(UNSUPPORTED_FEATURE, "Calibration is not supported in the MPI build.\n");
+    }
+    clean_table_file_mpi(&opts);
+#else
+    // Calibration starts from the defaults
+    if(!opts.calibrate) {
+        load_execution_profile(&opts);
     }
 
-    // if(opts.derivs == DERIVS_RECOMPUTE) {
-    //     recompute_derivs(table);
-    // }
-
-    info("Recomputing cs2\n");
-    recompute_cs2_and_check_physical_limits(table);
-
-    info("Validating table\n");
-    validate_table(table);
-
-    write_stellar_collapse_eos_table(table, opts.output_table_path);
-    info("Successfully wrote clean table to file '%s'\n", opts.output_table_path);
+    if(opts.calibrate) {
+        calibrate_execution_profile(&opts);
+    }
+    else if(opts.n_benchmark_lookups) {
+        benchmark_table_lookups(&opts);
+    }
+    else if(opts.n_scan_samples) {
+        scan_tables(&opts);
+    }
+    else if(opts.apply_patch_path[0] != '\0') {
+        apply_table_patch(opts.input_table_path, opts.apply_patch_path, opts.output_table_path);
+    }
+    else if(opts.batch) {
+        clean_table_batch(&opts);
+    }
+    else {
+        clean_table_file(&opts);
+    }
+#endif
 
-    free(table);
+    free_cmd_args(&opts);
 
     info("All done!\n");
+    flush_log();
+#ifdef USE_MPI
+    MPI_Finalize();
+#endif
     return 0;
 }
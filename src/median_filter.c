@@ -1,8 +1,14 @@
+#include <inttypes.h>
 #include <math.h>
 #include <stdbool.h>
 #include <string.h>
 
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
 #include "basic_types.h"
+#include "execution_profile.h"
 #include "median_filter.h"
 #include "utils.h"
 
@@ -15,20 +21,23 @@ compare_f64(const void *ap, const void *bp)
 }
 
 static void
-median_filter_fill_buffer(u32 nr, u32 nt, i32 width, u32 ir, u32 it, u32 iy, f64 *deriv, f64 *buffer)
+median_filter_fill_buffer(u64 nr, u64 nt, i32 width, u64 ir, u64 it, u64 iy, const f64 *deriv, f64 *buffer)
 {
-    u32 i = 0;
+    // Hoist the 64-bit index arithmetic out of the contiguous rho rows so the copies vectorize
+    const i32 row_size = 2 * width + 1;
     for(i32 iWy = -width; iWy <= width; iWy++) {
         for(i32 iWt = -width; iWt <= width; iWt++) {
-            for(i32 iWr = -width; iWr <= width; iWr++) {
-                buffer[i++] = deriv[INDEX(ir + iWr, it + iWt, iy + iWy)];
+            const f64 *row = deriv + INDEX(ir - width, it + iWt, iy + iWy);
+            for(i32 iWr = 0; iWr < row_size; iWr++) {
+                buffer[iWr] = row[iWr];
             }
+            buffer += row_size;
         }
     }
 }
 
 static f64
-median_filter_find_median(const u32 size, f64 *buffer)
+median_filter_find_median(const u64 size, f64 *buffer)
 {
     qsort(buffer, size, sizeof(f64), compare_f64);
 
@@ -39,36 +48,484 @@ median_filter_find_median(const u32 size, f64 *buffer)
     return 0.5 * (buffer[(size - 1) / 2] + buffer[size / 2]);
 }
 
+bool
+is_median_filter_outlier(
+    const u64  nr,
+    const u64  nt,
+    const u64  ir,
+    const u64  it,
+    const u64  iy,
+    const f64 *data,
+    f64       *median
+)
+{
+    f64 buffer[MF_S];
+    median_filter_fill_buffer(nr, nt, MF_W, ir, it, iy, data, buffer);
+    *median = median_filter_find_median(MF_S, buffer);
+    return fabs(*median - data[INDEX(ir, it, iy)]) / fabs(*median) > DELTASMOOTH;
+}
+
+static inline u32
+f32_to_order_key(const f32 x)
+{
+    u32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    // Flip all bits of negative numbers and the sign bit of positive ones, so that keys compare like the values
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+static inline f32
+order_key_to_f32(const u32 key)
+{
+    const u32 bits = key & 0x80000000u ? key & 0x7FFFFFFFu : ~key;
+    f32       x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static void
+median_filter_fill_keys(u64 nr, u64 nt, i32 width, u64 ir, u64 it, u64 iy, const u32 *keys, u32 *buffer)
+{
+    const i32 row_size = 2 * width + 1;
+    for(i32 iWy = -width; iWy <= width; iWy++) {
+        for(i32 iWt = -width; iWt <= width; iWt++) {
+            const u32 *row = keys + INDEX(ir - width, it + iWt, iy + iWy);
+            for(i32 iWr = 0; iWr < row_size; iWr++) {
+                buffer[iWr] = row[iWr];
+            }
+            buffer += row_size;
+        }
+    }
+}
+
+// Returns the k-th smallest key (quickselect); the buffer is partially reordered
+static u32
+median_filter_select_key(const i64 size, const i64 k, u32 *buffer)
+{
+    i64 lo = 0, hi = size - 1;
+    while(lo < hi) {
+        const u32 pivot = buffer[lo + (hi - lo) / 2];
+        i64       i     = lo;
+        i64       j     = hi;
+        while(i <= j) {
+            while(buffer[i] < pivot) {
+                i++;
+            }
+            while(buffer[j] > pivot) {
+                j--;
+            }
+            if(i <= j) {
+                const u32 tmp = buffer[i];
+                buffer[i++]   = buffer[j];
+                buffer[j--]   = tmp;
+            }
+        }
+        // Now [lo, j] <= pivot <= [i, hi], and the points in between equal the pivot
+        if(k <= j) {
+            hi = j;
+        }
+        else if(k >= i) {
+            lo = i;
+        }
+        else {
+            break;
+        }
+    }
+    return buffer[k];
+}
+
+static u64
+clamp_to_interior(const u64 index, const u64 n)
+{
+    // Points within MF_W of the table boundaries are never filtered
+    const u64 lo = MF_W;
+    const u64 hi = n > 2 * MF_W ? n - MF_W : MF_W;
+    return index < lo ? lo : (index > hi ? hi : index);
+}
+
 void
 apply_median_filter(stellar_collapse_eos *table, stellar_collapse_eos_quantity name)
 {
+    const index_box_t box = {
+        {0,            0,                    0          },
+        {table->n_rho, table->n_temperature, table->n_ye},
+    };
+    apply_median_filter_in_box(table, name, &box);
+}
+
+void
+apply_median_filter_in_box(stellar_collapse_eos *table, stellar_collapse_eos_quantity name, const index_box_t *box)
+{
+    apply_median_filter_to_quantities(table, &name, 1, box, false, NULL, NULL, NULL);
+}
+
+static u64
+median_filter_tile(
+    const u64  nr,
+    const u64  nt,
+    const u64  ir_min,
+    const u64  ir_max,
+    const u64  it_min,
+    const u64  it_max,
+    const u64  iy_min,
+    const u64  iy_max,
+    const u64 *in_lo,
+    const u64 *in_n,
+    const f64 *in,
+    f64       *deriv
+)
+{
+    // The snapshot 'in' only covers the box and its halo, starting at table point in_lo
+    u64 replaced = 0;
+    for(u64 iy = iy_min; iy < iy_max; ++iy) {
+        for(u64 it = it_min; it < it_max; ++it) {
+            for(u64 ir = ir_min; ir < ir_max; ++ir) {
+                f64 avg;
+                if(is_median_filter_outlier(in_n[0], in_n[1], ir - in_lo[0], it - in_lo[1], iy - in_lo[2], in, &avg)) {
+                    deriv[INDEX(ir, it, iy)] = avg;
+                    replaced++;
+                }
+            }
+        }
+    }
+    return replaced;
+}
+
+/**
+ * @brief Points replaced by a tile in single precision mode.
+ *
+ * They are only written to the table once all tiles are done, so that the double precision test can read the
+ * original data from the table.
+ */
+typedef struct
+{
+    u64  n, capacity; ///< Number of replaced points and room in the arrays.
+    u64 *indices;     ///< Indices of the replaced points.
+    f64 *values;      ///< New values of the replaced points.
+    u64  n_flipped;   ///< Points where the single and double precision tests disagree.
+} median_filter_replacements;
 
-    const u32 nr    = table->n_rho;
-    const u32 nt    = table->n_temperature;
-    const u32 ny    = table->n_ye;
-    f64      *deriv = table->data[name];
+// Runs inside the tasks of the median filter, so it cannot call error(): returns false if the list cannot grow
+static bool
+add_replacement(median_filter_replacements *replacements, const u64 index, const f64 value)
+{
+    if(replacements->n == replacements->capacity) {
+        const u64 capacity = replacements->capacity ? 2 * replacements->capacity : 64;
+        u64      *indices  = realloc(replacements->indices, sizeof(u64) * capacity);
+        if(indices) {
+            replacements->indices = indices;
+        }
+        f64 *values = realloc(replacements->values, sizeof(f64) * capacity);
+        if(values) {
+            replacements->values = values;
+        }
+        if(!indices || !values) {
+            return false;
+        }
+        replacements->capacity = capacity;
+    }
+    replacements->indices[replacements->n]  = index;
+    replacements->values[replacements->n++] = value;
+    return true;
+}
 
-    size_t size = sizeof(f64) * nr * nt * ny;
-    f64   *in   = (f64 *)malloc_or_error(size);
-    memcpy(in, deriv, size);
+static bool
+median_filter_tile_f32(
+    const stellar_collapse_eos_quantity qty,
+    const u64                           nr,
+    const u64                           nt,
+    const u64                           ir_min,
+    const u64                           ir_max,
+    const u64                           it_min,
+    const u64                           it_max,
+    const u64                           iy_min,
+    const u64                           iy_max,
+    const u64                          *in_lo,
+    const u64                          *in_n,
+    const u32                          *in,
+    const f64                          *data,
+    median_filter_replacements         *replacements
+)
+{
+    // The snapshot 'in' holds order keys of the single precision values; 'data' is the unmodified table
+    for(u64 iy = iy_min; iy < iy_max; ++iy) {
+        for(u64 it = it_min; it < it_max; ++it) {
+            for(u64 ir = ir_min; ir < ir_max; ++ir) {
+                u32 buffer[MF_S];
+                median_filter_fill_keys(
+                    in_n[0],
+                    in_n[1],
+                    MF_W,
+                    ir - in_lo[0],
+                    it - in_lo[1],
+                    iy - in_lo[2],
+                    in,
+                    buffer
+                );
 
-    // filter, overwriting as needed
+                // The single precision median is within a relative 2^-24 of the double precision one, unless it is
+                // zero, subnormal, or out of range; only points near the threshold need the double precision test
+                const f32  median32   = order_key_to_f32(median_filter_select_key(MF_S, MF_S / 2, buffer));
+                const f64  ratio      = fabs(median32 - data[INDEX(ir, it, iy)]) / fabs(median32);
+                const f64  margin     = fabs(ratio - DELTASMOOTH) / DELTASMOOTH;
+                const bool outlier32  = ratio > DELTASMOOTH;
+                const bool borderline = !isnormal(median32) || margin <= MF_F32_MARGIN;
+                if(!outlier32 && !borderline) {
+                    continue;
+                }
+
+                // The replacement value is always the double precision median
+                f64        median;
+                const bool outlier = is_median_filter_outlier(nr, nt, ir, it, iy, data, &median);
+                if(outlier != outlier32) {
+                    replacements->n_flipped++;
+                    WARN_RATE_LIMITED(
+                        "Median filter test of '%s' at point (%" PRIu64 ", %" PRIu64 ", %" PRIu64
+                        ") differs in single precision\n",
+                        stellar_collapse_qty_to_str(qty),
+                        ir,
+                        it,
+                        iy
+                    );
+                }
+                if(outlier && !add_replacement(replacements, INDEX(ir, it, iy), median)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+u64
+count_median_filter_tiles(const index_box_t *box, const u64 tile_edge)
+{
+    const u64 n_tiles_t = (box->hi[1] - box->lo[1] + tile_edge - 1) / tile_edge;
+    const u64 n_tiles_y = (box->hi[2] - box->lo[2] + tile_edge - 1) / tile_edge;
+    return n_tiles_t * n_tiles_y;
+}
+
+index_box_t
+get_median_filter_tile(const index_box_t *box, const u64 tile_edge, const u64 tile)
+{
+    const u64   n_tiles_t = (box->hi[1] - box->lo[1] + tile_edge - 1) / tile_edge;
+    index_box_t t         = *box;
+    t.lo[1]               = box->lo[1] + tile_edge * (tile % n_tiles_t);
+    t.lo[2]               = box->lo[2] + tile_edge * (tile / n_tiles_t);
+    t.hi[1]               = t.lo[1] + tile_edge < box->hi[1] ? t.lo[1] + tile_edge : box->hi[1];
+    t.hi[2]               = t.lo[2] + tile_edge < box->hi[2] ? t.lo[2] + tile_edge : box->hi[2];
+    return t;
+}
+
+void
+apply_median_filter_to_quantities(
+    stellar_collapse_eos                *table,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const index_box_t                   *box,
+    const bool                           single_precision,
+    u64                                 *n_replaced,
+    filtered_quantity_callback           on_done,
+    void                                *ctx
+)
+{
+    for(int q = 0; n_replaced && q < n_qtys; q++) {
+        n_replaced[q] = 0;
+    }
+
+    const u64 nr = table->n_rho;
+    const u64 nt = table->n_temperature;
+    const u64 ny = table->n_ye;
+
+    const u64 ir_min = clamp_to_interior(box->lo[0], nr);
+    const u64 ir_max = clamp_to_interior(box->hi[0], nr);
+    const u64 it_min = clamp_to_interior(box->lo[1], nt);
+    const u64 it_max = clamp_to_interior(box->hi[1], nt);
+    const u64 iy_min = clamp_to_interior(box->lo[2], ny);
+    const u64 iy_max = clamp_to_interior(box->hi[2], ny);
+
+    // Tile size and number of threads come from the execution profile
+    const execution_profile *profile = get_execution_profile();
+
+    const index_box_t interior = {
+        {ir_min, it_min, iy_min},
+        {ir_max, it_max, iy_max},
+    };
+    const u64 tile_edge     = profile->filter_tile;
+    const u64 tiles_per_qty = count_median_filter_tiles(&interior, tile_edge);
+    if(tiles_per_qty == 0 || ir_min == ir_max) {
+        for(int q = 0; on_done && q < n_qtys; q++) {
+            on_done(ctx, table, qtys[q], 0);
+        }
+        return;
+    }
+
+    // Group quantities until there are enough tiles to keep every thread busy
+    int n_threads = 1;
 #ifdef _OPENMP
-#    pragma omp parallel for collapse(3)
+    n_threads = profile->filter_threads > 0 ? profile->filter_threads : omp_get_max_threads();
 #endif
-    for(u32 iy = MF_W; iy < ny - MF_W; ++iy) {
-        for(u32 it = MF_W; it < nt - MF_W; ++it) {
-            for(u32 ir = MF_W; ir < nr - MF_W; ++ir) {
-                f64       buffer[MF_S];
-                const u32 index = INDEX(ir, it, iy);
-                median_filter_fill_buffer(nr, nt, MF_W, ir, it, iy, in, buffer);
-                const f64  avg = median_filter_find_median(MF_S, buffer);
-                const bool bad = fabs(avg - in[index]) / fabs(avg) > DELTASMOOTH;
-                if(bad) {
-                    deriv[index] = avg;
+    int group_size = (MF_TASKS_PER_THREAD * n_threads + tiles_per_qty - 1) / tiles_per_qty;
+    group_size     = group_size < 1 ? 1 : (group_size > n_qtys ? n_qtys : group_size);
+
+    // Number of points replaced in each tile, used to track the modified Ye planes
+    u64 *tile_replaced = malloc_or_error(sizeof(u64) * group_size * tiles_per_qty);
+
+    // In single precision mode, the points replaced by each tile are collected and written after all tiles are done
+    median_filter_replacements *replacements = NULL;
+    if(single_precision) {
+        replacements = malloc_or_error(sizeof(median_filter_replacements) * group_size * tiles_per_qty);
+    }
+
+    // Snapshots cover the box and the halo read by the filter window, so their size scales with the box
+    const u64    in_lo[3] = {ir_min - MF_W, it_min - MF_W, iy_min - MF_W};
+    const u64    in_n[3]  = {ir_max - ir_min + 2 * MF_W, it_max - it_min + 2 * MF_W, iy_max - iy_min + 2 * MF_W};
+    const size_t size     = (single_precision ? sizeof(u32) : sizeof(f64)) * in_n[0] * in_n[1] * in_n[2];
+    for(int first = 0; first < n_qtys; first += group_size) {
+        const int n_group = first + group_size > n_qtys ? n_qtys - first : group_size;
+
+        const void *in[number_of_eos_quantities];
+        f64        *out[number_of_eos_quantities];
+        for(int q = 0; q < n_group; q++) {
+            // Not malloc_or_error, so the snapshots already taken can be released first
+            void *copy = malloc(size);
+            if(!copy) {
+                for(int p = 0; p < q; p++) {
+                    free((void *)in[p]);
+                }
+                free(tile_replaced);
+                free(replacements);
+                error(OUT_OF_MEMORY, "Could not allocate %zu bytes for the median filter.\n", size);
+            }
+            out[q] = table->data[qtys[first + q]];
+            for(u64 iy = 0; iy < in_n[2]; iy++) {
+                for(u64 it = 0; it < in_n[1]; it++) {
+                    const f64 *row    = out[q] + INDEX(in_lo[0], in_lo[1] + it, in_lo[2] + iy);
+                    const u64  offset = in_n[0] * (it + in_n[1] * iy);
+                    if(single_precision) {
+                        u32 *keys = (u32 *)copy + offset;
+                        for(u64 ir = 0; ir < in_n[0]; ir++) {
+                            keys[ir] = f32_to_order_key((f32)row[ir]);
+                        }
+                    }
+                    else {
+                        memcpy((f64 *)copy + offset, row, sizeof(f64) * in_n[0]);
+                    }
                 }
             }
+            in[q] = copy;
+        }
+
+        // filter, overwriting as needed. Errors cannot leave the tasks, so they are raised after the parallel region
+        const u64 n_tasks       = n_group * tiles_per_qty;
+        bool      out_of_memory = false;
+#ifdef _OPENMP
+#    pragma omp parallel num_threads(n_threads)
+#    pragma omp single
+#    pragma omp taskloop grainsize(1)
+#endif
+        for(u64 task = 0; task < n_tasks; task++) {
+            const u64         q      = task / tiles_per_qty;
+            const index_box_t t      = get_median_filter_tile(&interior, tile_edge, task % tiles_per_qty);
+            const u64         it_beg = t.lo[1], it_end = t.hi[1];
+            const u64         iy_beg = t.lo[2], iy_end = t.hi[2];
+            if(!single_precision) {
+                tile_replaced[task] = median_filter_tile(
+                    nr,
+                    nt,
+                    ir_min,
+                    ir_max,
+                    it_beg,
+                    it_end,
+                    iy_beg,
+                    iy_end,
+                    in_lo,
+                    in_n,
+                    (const f64 *)in[q],
+                    out[q]
+                );
+                continue;
+            }
+            const median_filter_replacements empty = {0, 0, NULL, NULL, 0};
+            replacements[task]                     = empty;
+            const bool                       done  = median_filter_tile_f32(
+                qtys[first + q],
+                nr,
+                nt,
+                ir_min,
+                ir_max,
+                it_beg,
+                it_end,
+                iy_beg,
+                iy_end,
+                in_lo,
+                in_n,
+                (const u32 *)in[q],
+                out[q],
+                &replacements[task]
+            );
+            if(!done) {
+#ifdef _OPENMP
+#    pragma omp atomic write
+#endif
+                out_of_memory = true;
+            }
+            tile_replaced[task] = replacements[task].n;
+        }
+
+        if(out_of_memory) {
+            for(u64 task = 0; task < n_tasks; task++) {
+                free(replacements[task].indices);
+                free(replacements[task].values);
+            }
+            for(int q = 0; q < n_group; q++) {
+                free((void *)in[q]);
+            }
+            free(tile_replaced);
+            free(replacements);
+            error(OUT_OF_MEMORY, "Could not grow the list of points replaced by the median filter.\n");
+        }
+
+        for(int q = 0; single_precision && q < n_group; q++) {
+            u64 qty_flipped = 0;
+            for(u64 tile = 0; tile < tiles_per_qty; tile++) {
+                median_filter_replacements *r = &replacements[q * tiles_per_qty + tile];
+                for(u64 n = 0; n < r->n; n++) {
+                    out[q][r->indices[n]] = r->values[n];
+                }
+                qty_flipped += r->n_flipped;
+                free(r->indices);
+                free(r->values);
+            }
+            if(qty_flipped) {
+                info(
+                    "  %-9s: %" PRIu64 " points where the single precision test was overruled\n",
+                    stellar_collapse_qty_to_str(qtys[first + q]),
+                    qty_flipped
+                );
+            }
+        }
+
+        for(int q = 0; q < n_group; q++) {
+            free((void *)in[q]);
+            u64 qty_replaced = 0;
+            for(u64 tile = 0; tile < tiles_per_qty; tile++) {
+                const u64 replaced = tile_replaced[q * tiles_per_qty + tile];
+                if(!replaced) {
+                    continue;
+                }
+                const index_box_t t = get_median_filter_tile(&interior, tile_edge, tile);
+                mark_ye_planes_modified(table, qtys[first + q], t.lo[2], t.hi[2]);
+                qty_replaced += replaced;
+            }
+            if(n_replaced) {
+                n_replaced[first + q] = qty_replaced;
+            }
+            if(on_done) {
+                on_done(ctx, table, qtys[first + q], qty_replaced);
+            }
         }
     }
-    free(in);
+    free(tile_replaced);
+    free(replacements);
 }
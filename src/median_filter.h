@@ -7,12 +7,33 @@
 #ifndef MEDIAN_FILTER_H
 #define MEDIAN_FILTER_H
 
+#include <stdbool.h>
+
 #include "stellar_collapse_eos.h"
 
-#define DELTASMOOTH       (10.0)                                             ///< Smoothing parameter delta.
-#define MF_W              (3)                                                ///< Median filter window half-width.
-#define MF_S              ((2 * MF_W + 1) * (2 * MF_W + 1) * (2 * MF_W + 1)) ///< Median filter window size.
-#define INDEX(ir, it, iy) ((ir) + nr * ((it) + nt * (iy)))                   ///< Macro for calculating 3D index.
+#define DELTASMOOTH         (10.0)                                                    ///< Smoothing parameter delta.
+#define MF_W                (3)                                                       ///< Median filter window half-width.
+#define MF_S                ((2 * MF_W + 1) * (2 * MF_W + 1) * (2 * MF_W + 1))        ///< Median filter window size.
+#define INDEX(ir, it, iy)   ((u64)(ir) + (u64)nr * ((u64)(it) + (u64)nt * (u64)(iy))) ///< Macro for calculating 3D index (64-bit).
+#define MF_TILE             (4)                                                       ///< Default filter tile edge along T and Ye.
+#define MF_TASKS_PER_THREAD (4)                                                       ///< Tiles per thread before grouping.
+#define MF_F32_MARGIN       (1e-5) ///< Relative distance to DELTASMOOTH below which single precision tests are redone.
+
+/**
+ * @brief Evaluates the median filter criterion at an interior point of a quantity.
+ *
+ * A point is an outlier, i.e., it is replaced by the median filter, if it differs from the median of the window of
+ * MF_S points around it by more than DELTASMOOTH times the median.
+ *
+ * @param nr Number of density points.
+ * @param nt Number of temperature points.
+ * @param ir, it, iy Indices of the point, at least MF_W away from the table boundaries.
+ * @param data Array with the values of the quantity.
+ * @param median Output with the median of the window.
+ *
+ * @return Whether the point is an outlier.
+ */
+bool is_median_filter_outlier(u64 nr, u64 nt, u64 ir, u64 it, u64 iy, const f64 *data, f64 *median);
 
 /**
  * @brief Applies a 3D median filter to a specified quantity in the EOS table.
@@ -25,4 +46,84 @@
  */
 void apply_median_filter(stellar_collapse_eos *table, stellar_collapse_eos_quantity name);
 
+/**
+ * @brief Applies the 3D median filter to the points of a specified quantity inside a box.
+ *
+ * The box is clamped to the interior of the table, i.e., points closer than MF_W to the table boundaries are never
+ * filtered. Points outside the box are read by the filter window but never modified.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure containing the table data.
+ * @param name The specific stellar_collapse_eos_quantity to filter.
+ * @param box Pointer to the box of points to filter.
+ */
+void apply_median_filter_in_box(stellar_collapse_eos *table, stellar_collapse_eos_quantity name, const index_box_t *box);
+
+/**
+ * @brief Returns the number of filter tiles of a box (see get_median_filter_tile).
+ *
+ * @param box Pointer to the box of points to filter, already clamped to the interior of the table.
+ * @param tile_edge Edge of the tiles along temperature and Ye.
+ */
+u64 count_median_filter_tiles(const index_box_t *box, u64 tile_edge);
+
+/**
+ * @brief Returns the points of a filter tile: all densities of the box, and a square block of temperatures and Ye.
+ *
+ * Tiles are numbered with temperature varying fastest. The last tiles along each axis end at the box.
+ *
+ * @param box Pointer to the box of points to filter, already clamped to the interior of the table.
+ * @param tile_edge Edge of the tiles along temperature and Ye.
+ * @param tile Index of the tile, smaller than count_median_filter_tiles.
+ */
+index_box_t get_median_filter_tile(const index_box_t *box, u64 tile_edge, u64 tile);
+
+/**
+ * @brief Called as soon as a quantity has been filtered.
+ *
+ * @param ctx User data passed to apply_median_filter_to_quantities.
+ * @param table Pointer to the table, with the quantity already filtered.
+ * @param qty The quantity that was filtered.
+ * @param n_replaced Number of points replaced in the quantity.
+ */
+typedef void (*filtered_quantity_callback)(
+    void                         *ctx,
+    const stellar_collapse_eos   *table,
+    stellar_collapse_eos_quantity qty,
+    u64                           n_replaced
+);
+
+/**
+ * @brief Applies the 3D median filter to several quantities of the EOS table at once.
+ *
+ * The box of each quantity is split into square tiles of (temperature, Ye) columns, and all tiles are scheduled as
+ * OpenMP tasks, so idle threads pick up tiles from other quantities. The tile edge and the number of threads come from
+ * the execution profile (see execution_profile.h). Quantities are filtered concurrently only when a single quantity
+ * has too few tiles to keep all threads busy (small tables), which bounds the memory used by the snapshots of the
+ * unfiltered data.
+ *
+ * In single precision mode, the snapshots and windows hold order-preserving 32-bit keys of the values rounded to f32,
+ * and the median is found by quickselect. Points flagged as outliers, or within MF_F32_MARGIN of the threshold,
+ * are tested again in double precision on the original data, which also gives the replacement value. The filtered
+ * table is thus the same as in double precision mode; points where the two tests disagree are reported.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure containing the table data.
+ * @param qtys Array of quantities to filter.
+ * @param n_qtys Number of quantities to filter.
+ * @param box Pointer to the box of points to filter (see apply_median_filter_in_box).
+ * @param single_precision Whether to select the median in single precision.
+ * @param n_replaced Output array with the number of points replaced in each quantity (may be NULL).
+ * @param on_done Called for each quantity as soon as it is filtered (may be NULL).
+ * @param ctx Passed to on_done.
+ */
+void apply_median_filter_to_quantities(
+    stellar_collapse_eos                *table,
+    const stellar_collapse_eos_quantity *qtys,
+    const int                            n_qtys,
+    const index_box_t                   *box,
+    bool                                 single_precision,
+    u64                                 *n_replaced,
+    filtered_quantity_callback           on_done,
+    void                                *ctx
+);
+
 #endif // MEDIAN_FILTER_H
@@ -0,0 +1,354 @@
+#include <hdf5.h>
+#include <inttypes.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_table.h"
+#include "cleaner.h"
+#include "hdf5_helpers.h"
+#include "median_filter.h"
+#include "mpi_cleaner.h"
+#include "utils.h"
+
+/**
+ * @brief Describes the block of Ye planes owned by this rank.
+ *
+ * Local arrays are laid out as [lower halo | owned planes | upper halo].
+ */
+typedef struct
+{
+    int          rank, size;
+    i32          n_ye;             ///< Global number of Ye planes.
+    i32          iy_begin, iy_end; ///< Owned planes [iy_begin, iy_end) in global indices.
+    i32          n_own;            ///< Number of owned planes.
+    i32          halo_lo, halo_hi; ///< Number of halo planes below and above the owned block.
+    MPI_Datatype plane;            ///< One (rho, temperature) plane of f64.
+} ye_decomposition;
+
+static ye_decomposition
+decompose_along_ye(const i32 n_rho, const i32 n_temperature, const i32 n_ye)
+{
+    ye_decomposition d;
+    MPI_Comm_rank(MPI_COMM_WORLD, &d.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &d.size);
+
+    // Block distribution, spreading the remainder over the first ranks
+    const i32 base = n_ye / d.size;
+    const i32 rem  = n_ye % d.size;
+    d.n_ye         = n_ye;
+    d.iy_begin     = d.rank * base + (d.rank < rem ? d.rank : rem);
+    d.n_own        = base + (d.rank < rem ? 1 : 0);
+    d.iy_end       = d.iy_begin + d.n_own;
+    d.halo_lo      = d.rank > 0 ? MF_W : 0;
+    d.halo_hi      = d.rank < d.size - 1 ? MF_W : 0;
+
+    // Halos come from the nearest neighbours only, so every rank must own at least MF_W planes
+    if(base < MF_W) {
+        error(
+            INVALID_DECOMPOSITION,
+            "Cannot split %d Ye planes across %d ranks (need at least %d planes per rank)\n",
+            n_ye,
+            d.size,
+            MF_W
+        );
+    }
+
+    MPI_Type_contiguous(n_rho * n_temperature, MPI_DOUBLE, &d.plane);
+    MPI_Type_commit(&d.plane);
+
+    return d;
+}
+
+static stellar_collapse_eos *
+read_local_table(const char *filepath, ye_decomposition *d)
+{
+    if(is_binary_table_file(filepath)) {
+        error(UNSUPPORTED_FEATURE, "Binary tables are not supported in the MPI build.\n");
+    }
+
+    hid_t file_id = H5Fopen(filepath, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    stellar_collapse_eos *table = malloc_or_error(sizeof(stellar_collapse_eos));
+    memset(table, 0, sizeof(stellar_collapse_eos));
+
+    // Scalar quantities
+    i32 *n_rho           = read_hdf5_dataset(file_id, I32, "pointsrho");
+    i32 *n_temperature   = read_hdf5_dataset(file_id, I32, "pointstemp");
+    i32 *n_ye            = read_hdf5_dataset(file_id, I32, "pointsye");
+    f64 *energy_shift    = read_hdf5_dataset(file_id, F64, "energy_shift");
+    table->n_rho         = *n_rho;
+    table->n_temperature = *n_temperature;
+    table->energy_shift  = *energy_shift;
+    *d                   = decompose_along_ye(*n_rho, *n_temperature, *n_ye);
+    table->n_ye          = d->halo_lo + d->n_own + d->halo_hi;
+    free(n_rho);
+    free(n_temperature);
+    free(n_ye);
+    free(energy_shift);
+
+    // Basic tabulated quantities; the local Ye axis includes the halos
+    const hsize_t ye_offset = d->iy_begin - d->halo_lo;
+    const hsize_t ye_count  = table->n_ye;
+    table->ye               = malloc_or_error(sizeof(f64) * table->n_ye);
+    read_hdf5_dataset_hyperslab(file_id, F64, "ye", &ye_offset, &ye_count, table->ye);
+    table->log10_temperature = (f64 *)read_hdf5_dataset(file_id, F64, "logtemp");
+    table->log10_rho         = (f64 *)read_hdf5_dataset(file_id, F64, "logrho");
+
+    // Tabulated data: only the owned planes are read, halos are filled by exchange_halo_planes
+    const usize   plane_size = (usize)table->n_rho * table->n_temperature;
+    const hsize_t offset[3]  = {d->iy_begin, 0, 0};
+    const hsize_t count[3]   = {d->n_own, table->n_temperature, table->n_rho};
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        table->data[n] = malloc_or_error(sizeof(f64) * plane_size * table->n_ye);
+        read_hdf5_dataset_hyperslab(
+            file_id,
+            F64,
+            stellar_collapse_qty_to_str(n),
+            offset,
+            count,
+            table->data[n] + d->halo_lo * plane_size
+        );
+    }
+
+    H5Fclose(file_id);
+
+    return table;
+}
+
+static void
+exchange_halo_planes(const ye_decomposition *d, const usize plane_size, f64 *data)
+{
+    const int lower       = d->rank > 0 ? d->rank - 1 : MPI_PROC_NULL;
+    const int upper       = d->rank < d->size - 1 ? d->rank + 1 : MPI_PROC_NULL;
+    f64      *lower_halo  = data;
+    f64      *first_owned = data + d->halo_lo * plane_size;
+    f64      *upper_halo  = first_owned + d->n_own * plane_size;
+    f64      *last_owned  = upper_halo - d->halo_hi * plane_size;
+
+    // Send our first planes down while receiving the upper halo, then the other way around
+    MPI_Sendrecv(
+        first_owned,
+        d->halo_lo,
+        d->plane,
+        lower,
+        0,
+        upper_halo,
+        d->halo_hi,
+        d->plane,
+        upper,
+        0,
+        MPI_COMM_WORLD,
+        MPI_STATUS_IGNORE
+    );
+    MPI_Sendrecv(
+        last_owned,
+        d->halo_hi,
+        d->plane,
+        upper,
+        1,
+        lower_halo,
+        d->halo_lo,
+        d->plane,
+        lower,
+        1,
+        MPI_COMM_WORLD,
+        MPI_STATUS_IGNORE
+    );
+}
+
+#ifdef H5_HAVE_PARALLEL
+static void
+write_global_table(const stellar_collapse_eos *owned, const ye_decomposition *d, const char *filepath)
+{
+    hid_t fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(fapl_id, MPI_COMM_WORLD, MPI_INFO_NULL);
+    hid_t file_id = H5Fcreate(filepath, H5F_ACC_TRUNC, H5P_DEFAULT, fapl_id);
+    H5Pclose(fapl_id);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    hid_t xfer_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(xfer_id, H5FD_MPIO_COLLECTIVE);
+
+    // Scalars and the rho/temperature axes are written by rank 0 only
+    const hsize_t one       = 1;
+    const hsize_t zero      = 0;
+    const hsize_t root      = d->rank == 0 ? 1 : 0;
+    const hsize_t nr        = owned->n_rho;
+    const hsize_t nt        = owned->n_temperature;
+    const hsize_t ny        = d->n_ye;
+    const hsize_t nr_root   = d->rank == 0 ? nr : 0;
+    const hsize_t nt_root   = d->rank == 0 ? nt : 0;
+    const hsize_t iy_begin  = d->iy_begin;
+    const hsize_t n_own     = d->n_own;
+    const i32     n_ye      = d->n_ye;
+    const hsize_t dims[3]   = {ny, nt, nr};
+    const hsize_t offset[3] = {iy_begin, 0, 0};
+    const hsize_t count[3]  = {n_own, nt, nr};
+
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, I32, 1, &one, &zero, &root, &owned->n_rho, "pointsrho");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, I32, 1, &one, &zero, &root, &owned->n_temperature, "pointstemp");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, I32, 1, &one, &zero, &root, &n_ye, "pointsye");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, F64, 1, &one, &zero, &root, &owned->energy_shift, "energy_shift");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, F64, 1, &ny, &iy_begin, &n_own, owned->ye, "ye");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, F64, 1, &nt, &zero, &nt_root, owned->log10_temperature, "logtemp");
+    write_hdf5_dataset_hyperslab(file_id, xfer_id, F64, 1, &nr, &zero, &nr_root, owned->log10_rho, "logrho");
+
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        write_hdf5_dataset_hyperslab(
+            file_id,
+            xfer_id,
+            F64,
+            3,
+            dims,
+            offset,
+            count,
+            owned->data[n],
+            stellar_collapse_qty_to_str(n)
+        );
+    }
+
+    H5Pclose(xfer_id);
+    H5Fclose(file_id);
+}
+#else
+static void
+write_global_table(const stellar_collapse_eos *owned, const ye_decomposition *d, const char *filepath)
+{
+    // Serial HDF5: gather one quantity at a time on rank 0, which writes the file
+    int *counts = malloc_or_error(sizeof(int) * d->size);
+    int *displs = malloc_or_error(sizeof(int) * d->size);
+    MPI_Allgather(&d->n_own, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+    MPI_Allgather(&d->iy_begin, 1, MPI_INT, displs, 1, MPI_INT, MPI_COMM_WORLD);
+
+    stellar_collapse_eos global = *owned;
+    global.n_ye                 = d->n_ye;
+
+    const usize plane_size = (usize)owned->n_rho * owned->n_temperature;
+    f64        *buffer     = NULL;
+    if(d->rank == 0) {
+        global.ye = malloc_or_error(sizeof(f64) * d->n_ye);
+        buffer    = malloc_or_error(sizeof(f64) * plane_size * d->n_ye);
+    }
+    MPI_Gatherv(owned->ye, d->n_own, MPI_DOUBLE, global.ye, counts, displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    hid_t file_id = -1;
+    if(d->rank == 0) {
+        file_id = H5Fcreate(filepath, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        if(file_id < 0) {
+            error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+        }
+
+        const hsize_t dims[4] = {1, global.n_ye, global.n_temperature, global.n_rho};
+        write_hdf5_dataset(file_id, I32, 1, dims, &global.n_rho, "pointsrho");
+        write_hdf5_dataset(file_id, I32, 1, dims, &global.n_temperature, "pointstemp");
+        write_hdf5_dataset(file_id, I32, 1, dims, &global.n_ye, "pointsye");
+        write_hdf5_dataset(file_id, F64, 1, dims, &global.energy_shift, "energy_shift");
+        write_hdf5_dataset(file_id, F64, 1, dims + 1, global.ye, "ye");
+        write_hdf5_dataset(file_id, F64, 1, dims + 2, global.log10_temperature, "logtemp");
+        write_hdf5_dataset(file_id, F64, 1, dims + 3, global.log10_rho, "logrho");
+    }
+
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        MPI_Gatherv(owned->data[n], d->n_own, d->plane, buffer, counts, displs, d->plane, 0, MPI_COMM_WORLD);
+        if(d->rank == 0) {
+            const hsize_t dims[3] = {global.n_ye, global.n_temperature, global.n_rho};
+            write_hdf5_dataset(file_id, F64, 3, dims, buffer, stellar_collapse_qty_to_str(n));
+        }
+    }
+
+    if(d->rank == 0) {
+        H5Fclose(file_id);
+        free(global.ye);
+        free(buffer);
+    }
+    free(counts);
+    free(displs);
+}
+#endif
+
+void
+clean_table_file_mpi(const options_t *opts)
+{
+    if(opts->batch) {
+        error(UNSUPPORTED_FEATURE, "Batch mode is not supported in the MPI build.\n");
+    }
+
+    ye_decomposition      d;
+    stellar_collapse_eos *table = read_local_table(opts->input_table_path, &d);
+    info("Successfully read table from file '%s' using %d ranks\n", opts->input_table_path, d.size);
+
+    const usize plane_size = (usize)table->n_rho * table->n_temperature;
+
+    // Only the owned planes are filtered; the box is further clamped to the global interior because the first and
+    // last ranks have no halo on the table boundaries.
+    const index_box_t box = {
+        {0,            0,                    d.halo_lo          },
+        {table->n_rho, table->n_temperature, d.halo_lo + d.n_own},
+    };
+
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+
+    const int n_qtys = select_quantities_to_filter(opts, qtys);
+    u64 n_replaced[number_of_eos_quantities];
+    for(int n = 0; n < n_qtys; n++) {
+        exchange_halo_planes(&d, plane_size, table->data[qtys[n]]);
+    }
+    apply_median_filter_to_quantities(table, qtys, n_qtys, &box, opts->median_single_precision, n_replaced, NULL, NULL);
+    MPI_Allreduce(MPI_IN_PLACE, n_replaced, n_qtys, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    for(int n = 0; n < n_qtys; n++) {
+        info("  %-9s: %" PRIu64 " points replaced\n", stellar_collapse_qty_to_str(qtys[n]), n_replaced[n]);
+    }
+    flush_log();
+
+    // View of the owned planes, without the halos
+    stellar_collapse_eos owned = *table;
+    owned.n_ye                 = d.n_own;
+    owned.ye                   = table->ye + d.halo_lo;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        owned.data[n] = table->data[n] + d.halo_lo * plane_size;
+    }
+
+    // Each rank counts the points of its own planes; the counts are combined before rank 0 reports them
+    info("Recomputing cs2\n");
+    const index_box_t owned_box = {
+        {0,           0,                   0         },
+        {owned.n_rho, owned.n_temperature, owned.n_ye},
+    };
+    cs2_limits_report cs2 = recompute_cs2_in_box(&owned, &owned_box);
+    MPI_Allreduce(MPI_IN_PLACE, &cs2.n_points, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &cs2.n_negative, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &cs2.n_superluminal, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if(d.rank == 0) {
+        print_cs2_limits_report(&cs2);
+    }
+    flush_log();
+
+    // The rho and temperature axes are the same on every rank, so only the Ye axis and the data are summed. The pair
+    // of Ye points across the lower rank boundary is checked with the halo.
+    info("Validating table\n");
+    validation_report validation = count_table_problems(&owned, false);
+    if(d.halo_lo > 0 && owned.ye[-1] > owned.ye[0]) {
+        validation.axis_problems[2]++;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &validation.n_points, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &validation.axis_sizes[2], 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &validation.axis_problems[2], 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, validation.nans, number_of_eos_quantities, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, validation.infs, number_of_eos_quantities, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if(d.rank == 0) {
+        print_validation_report(&validation);
+    }
+    flush_log();
+
+    write_global_table(&owned, &d, opts->output_table_path);
+    info("Successfully wrote clean table to file '%s'\n", opts->output_table_path);
+
+    MPI_Type_free(&d.plane);
+    free_stellar_collapse_eos_table(table);
+}
@@ -0,0 +1,24 @@
+/**
+ * @file mpi_cleaner.h
+ * @author Leo Werneck
+ *
+ * @brief Distributed cleaning of a single EOS table with MPI (only built by 'make mpi').
+ */
+#ifndef MPI_CLEANER_H
+#define MPI_CLEANER_H
+
+#include "options.h"
+
+/**
+ * @brief Reads, cleans, and writes a single EOS table using all ranks in MPI_COMM_WORLD.
+ *
+ * The table is split along Ye into contiguous blocks of planes, one per rank. Each rank reads its own block from the
+ * input file, exchanges MF_W halo planes with its neighbours before filtering each quantity, and recomputes cs2 on the
+ * planes it owns. The output is written with collective hyperslab writes when HDF5 was built with parallel support;
+ * otherwise each quantity is gathered on rank 0 and written from there.
+ *
+ * @param opts Pointer to the command line options.
+ */
+void clean_table_file_mpi(const options_t *opts);
+
+#endif // MPI_CLEANER_H
@@ -1,9 +1,22 @@
+// Needed for glob(3) and mkdir(2)
+#define _POSIX_C_SOURCE 200809L
+
 #include <ctype.h>
+#include <glob.h>
+#include <inttypes.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "basic_types.h"
+#include "binary_table.h"
+#include "calibrate.h"
+#include "interleaved_layout.h"
 #include "options.h"
+#include "precision.h"
 #include "utils.h"
 
 static bool
@@ -90,21 +103,274 @@ derivs_to_str(const derivs_t derivs)
     }
 }
 
+static void
+add_input_table_path(options_t *options, const char *path)
+{
+    const usize len = strlen(path) + 1;
+
+    options->input_table_paths = realloc(options->input_table_paths, sizeof(char *) * (options->n_input_tables + 1));
+    if(!options->input_table_paths) {
+        error(OUT_OF_MEMORY, "Could not allocate memory for input table list.\n");
+    }
+    options->input_table_paths[options->n_input_tables] = malloc_or_error(len);
+    memcpy(options->input_table_paths[options->n_input_tables], path, len);
+    options->n_input_tables++;
+}
+
+static void
+add_input_table_pattern(options_t *options, const char *pattern)
+{
+    // Patterns are usually expanded by the shell, but quoting them avoids hitting
+    // the argument length limit when there are many tables.
+    if(!strpbrk(pattern, "*?[")) {
+        add_input_table_path(options, pattern);
+        return;
+    }
+
+    glob_t matches;
+    if(glob(pattern, 0, NULL, &matches) != 0) {
+        error(FILE_OPEN_FAILED, "No input tables match the pattern '%s'\n", pattern);
+    }
+    for(usize n = 0; n < matches.gl_pathc; n++) {
+        add_input_table_path(options, matches.gl_pathv[n]);
+    }
+    globfree(&matches);
+}
+
+void
+set_default_output_path(const options_t *opts, const char *input_path, char *output_path, const int size)
+{
+    // Remove the extension and, if writing to an output directory, the input directory
+    const char *output_dir = opts->output_dir;
+    const char *extension  = opts->output_format == FORMAT_BINARY ? BINARY_TABLE_EXTENSION : ".h5";
+    const char *slash      = strrchr(input_path, '/');
+    const char *name       = slash ? slash + 1 : input_path;
+    const char *base       = output_dir[0] != '\0' ? name : input_path;
+    const char *dot        = strrchr(name, '.');
+    const int   len        = dot ? (int)(dot - base) : (int)strlen(base);
+
+    if(output_dir[0] != '\0') {
+        snprintf(output_path, size, "%s/%.*s_clean%s", output_dir, len, base, extension);
+    }
+    else {
+        snprintf(output_path, size, "%.*s_clean%s", len, base, extension);
+    }
+}
+
+static void
+parse_range(const char *str, const char *opt, const bool positive, f64 *min, f64 *max)
+{
+    char *sep, *end;
+    *min = strtod(str, &sep);
+    end  = sep;
+    *max = *sep == ':' ? strtod(sep + 1, &end) : 0;
+    if(sep == str || *sep != ':' || end == sep + 1 || *end != '\0' || *min > *max || (positive && *min <= 0)) {
+        const char *bounds = positive ? "0 < min <= max" : "min <= max";
+        error(UNKNOWN_OPTION, "Option '%s' expects <min>:<max> with %s, but got '%s'\n", opt, bounds, str);
+    }
+}
+
+static log_level_t
+get_log_level_from_str(const char *str)
+{
+    if(streq(str, "error")) {
+        return LOG_ERROR;
+    }
+    else if(streq(str, "warning")) {
+        return LOG_WARNING;
+    }
+    else if(streq(str, "info")) {
+        return LOG_INFO;
+    }
+    else if(streq(str, "debug")) {
+        return LOG_DEBUG;
+    }
+    else {
+        error(UNKNOWN_OPTION, "Unknown log level '%s'\n", str);
+        return LOG_DEBUG;
+    }
+}
+
+static layout_t
+get_layout_from_str(const char *str)
+{
+    if(streq(str, "planar")) {
+        return LAYOUT_PLANAR;
+    }
+    else if(streq(str, "interleaved")) {
+        return LAYOUT_INTERLEAVED;
+    }
+    else {
+        error(UNKNOWN_OPTION, "Unknown layout '%s'\n", str);
+        return LAYOUT_PLANAR;
+    }
+}
+
+static output_format_t
+get_output_format_from_str(const char *str)
+{
+    if(streq(str, "hdf5")) {
+        return FORMAT_HDF5;
+    }
+    else if(streq(str, "binary")) {
+        return FORMAT_BINARY;
+    }
+    else {
+        error(UNKNOWN_OPTION, "Unknown output format '%s'\n", str);
+        return FORMAT_HDF5;
+    }
+}
+
+static char *
+output_mode_to_str(const output_mode_t output_mode)
+{
+    switch(output_mode) {
+        case OUTPUT_REWRITE:
+            return "rewrite";
+        case OUTPUT_COPY_THROUGH:
+            return "copy unmodified datasets";
+        case OUTPUT_IN_PLACE:
+            return "update input in place";
+        default:
+            return "invalid output mode";
+    }
+}
+
+// Returns the value of the option at argv[*n] and advances past it
+static char *
+next_arg(const int argc, char **argv, int *n)
+{
+    if(*n + 1 >= argc) {
+        error(UNKNOWN_OPTION, "Option '%s' needs a value\n", argv[*n]);
+    }
+    return argv[++*n];
+}
+
 options_t
 parse_cmd_args(int argc, char **argv)
 {
-    options_t options = {0};
-    options.smoother  = SMOOTH_DERIVS_ONLY;
-    options.derivs    = DERIVS_SMOOTH;
+    options_t options   = {0};
+    options.smoother    = SMOOTH_DERIVS_ONLY;
+    options.derivs      = DERIVS_SMOOTH;
+    options.overlap_io  = true;
+    options.layout_tile = 1;
+    for(int axis = 0; axis < 3; axis++) {
+        // Density and temperature are mapped onto logarithmic axes
+        options.roi_min[axis] = axis < 2 ? 0 : -HUGE_VAL;
+        options.roi_max[axis] = HUGE_VAL;
+    }
 
     for(int n = 1; n < argc; n++) {
         char *opt = argv[n];
 
         if(streq(opt, "--output") || streq(opt, "-o")) {
-            snprintf(options.output_table_path, 1024, "%s", argv[++n]);
+            snprintf(options.output_table_path, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--output-dir") || streq(opt, "-O")) {
+            snprintf(options.output_dir, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--no-overlap")) {
+            options.overlap_io = false;
+        }
+        else if(streq(opt, "--copy-through")) {
+            options.output_mode = OUTPUT_COPY_THROUGH;
+        }
+        else if(streq(opt, "--in-place")) {
+            options.output_mode = OUTPUT_IN_PLACE;
+        }
+        else if(streq(opt, "--output-format")) {
+            opt = next_arg(argc, argv, &n);
+            strlower(opt);
+            options.output_format = get_output_format_from_str(opt);
+        }
+        else if(streq(opt, "--layout")) {
+            opt = next_arg(argc, argv, &n);
+            strlower(opt);
+            options.layout = get_layout_from_str(opt);
+        }
+        else if(streq(opt, "--layout-qtys")) {
+            options.n_layout_qtys = parse_quantity_list(next_arg(argc, argv, &n), options.layout_qtys);
+        }
+        else if(streq(opt, "--layout-pad")) {
+            options.layout_pad = true;
+        }
+        else if(streq(opt, "--layout-tile")) {
+            options.layout_tile = atoi(next_arg(argc, argv, &n));
+            if(options.layout_tile < 1) {
+                error(UNKNOWN_OPTION, "Tile size must be a positive integer, but got '%s'\n", argv[n]);
+            }
+        }
+        else if(streq(opt, "--precision")) {
+            parse_precision_spec(next_arg(argc, argv, &n), options.precision);
+            options.reduce_precision = true;
+        }
+        else if(streq(opt, "--decimate")) {
+            options.decimate_tolerance = atof(next_arg(argc, argv, &n));
+            if(options.decimate_tolerance <= 0) {
+                error(UNKNOWN_OPTION, "Decimation tolerance must be positive, but got '%s'\n", argv[n]);
+            }
+        }
+        else if(streq(opt, "--decimate-qtys")) {
+            options.n_decimate_qtys = parse_quantity_list(next_arg(argc, argv, &n), options.decimate_qtys);
+        }
+        else if(streq(opt, "--benchmark")) {
+            const long long n_lookups = atoll(next_arg(argc, argv, &n));
+            if(n_lookups < 1) {
+                error(UNKNOWN_OPTION, "Number of lookups must be a positive integer, but got '%s'\n", argv[n]);
+            }
+            options.n_benchmark_lookups = n_lookups;
+        }
+        else if(streq(opt, "--scan")) {
+            const long long n_samples = atoll(next_arg(argc, argv, &n));
+            if(n_samples < 1) {
+                error(UNKNOWN_OPTION, "Number of samples must be a positive integer, but got '%s'\n", argv[n]);
+            }
+            options.n_scan_samples = n_samples;
+        }
+        else if(streq(opt, "--rho-range") || streq(opt, "--temp-range") || streq(opt, "--ye-range")) {
+            const int axis = streq(opt, "--rho-range") ? 0 : (streq(opt, "--temp-range") ? 1 : 2);
+            parse_range(next_arg(argc, argv, &n), opt, axis < 2, &options.roi_min[axis], &options.roi_max[axis]);
+            options.use_roi = true;
+        }
+        else if(streq(opt, "--median-f32")) {
+            options.median_single_precision = true;
+        }
+        else if(streq(opt, "--consistency")) {
+            options.check_consistency = true;
+        }
+        else if(streq(opt, "--consistency-mask")) {
+            snprintf(options.consistency_mask_path, 1024, "%s", next_arg(argc, argv, &n));
+            options.check_consistency = true;
+        }
+        else if(streq(opt, "--calibrate")) {
+            options.calibrate = true;
+        }
+        else if(streq(opt, "--profile-dir")) {
+            snprintf(options.profile_dir, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--cache-dir")) {
+            snprintf(options.cache_dir, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--checkpoint")) {
+            snprintf(options.checkpoint_path, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--resume")) {
+            options.resume = true;
+        }
+        else if(streq(opt, "--patch")) {
+            snprintf(options.patch_path, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--apply-patch")) {
+            snprintf(options.apply_patch_path, 1024, "%s", next_arg(argc, argv, &n));
+        }
+        else if(streq(opt, "--log-level")) {
+            opt = next_arg(argc, argv, &n);
+            strlower(opt);
+            // Applied right away, so that it also covers the summary of the options
+            set_log_level(get_log_level_from_str(opt));
         }
         else if(streq(opt, "--smoothing") || streq(opt, "-s")) {
-            opt = argv[++n];
+            opt = next_arg(argc, argv, &n);
             strlower(opt);
 
             options.smoother = get_smoother_from_str(opt);
@@ -112,8 +378,8 @@ parse_cmd_args(int argc, char **argv)
                 error(INVALID_SMOOTHER, "Unknown smoothing option '%s'\n", opt);
             }
         }
-        else if(streq(opt, "--derivs") || streq(opt, "d")) {
-            opt = argv[++n];
+        else if(streq(opt, "--derivs") || streq(opt, "-d")) {
+            opt = next_arg(argc, argv, &n);
             strlower(opt);
 
             options.derivs = get_derivs_from_str(opt);
@@ -122,32 +388,245 @@ parse_cmd_args(int argc, char **argv)
             }
         }
         else {
-            debug("opt = %s", opt);
+            debug("opt = %s\n", opt);
             if(opt[0] == '-') {
                 error(UNKNOWN_OPTION, "Unknown option '%s'\n", opt);
             }
-            if(options.input_table_path[0] != '\0') {
-                error(UNKNOWN_OPTION, "Unexpected positional argument '%s'\n", opt);
-            }
-            snprintf(options.input_table_path, 1024, "%s", opt);
+            add_input_table_pattern(&options, opt);
         }
     }
 
-    if(options.output_table_path[0] == '\0') {
-        // User didn't provide an output table path. Set it to default.
-        // Remove .h5 from input file
-        char *dot = strrchr(options.input_table_path, '.');
-        if(dot) {
-            *dot = '\0';
+    if(options.n_input_tables == 0) {
+        error(UNKNOWN_OPTION, "No input table provided\n");
+    }
+
+    // More than one table or an output directory selects batch mode
+    options.batch = options.n_input_tables > 1 || options.output_dir[0] != '\0';
+    if(options.batch && options.output_table_path[0] != '\0') {
+        error(UNKNOWN_OPTION, "Option '--output' cannot be used with multiple tables; use '--output-dir' instead\n");
+    }
+
+    if(options.output_mode == OUTPUT_IN_PLACE && (options.output_table_path[0] != '\0' || options.output_dir[0] != '\0')) {
+        error(UNKNOWN_OPTION, "Option '--in-place' cannot be used with '--output' or '--output-dir'\n");
+    }
+
+    // Created once here, so that batch mode does not fail on every table
+    struct stat st;
+    if(options.output_dir[0] != '\0' && mkdir(options.output_dir, 0755) != 0
+       && (stat(options.output_dir, &st) != 0 || !S_ISDIR(st.st_mode))) {
+        error(FILE_OPEN_FAILED, "Could not create output directory '%s'\n", options.output_dir);
+    }
+
+    if(options.batch && options.cache_dir[0] != '\0' && options.overlap_io) {
+        // The pipeline cleans tables without going through the cache
+        info("Option '--cache-dir' disables I/O overlap\n");
+        options.overlap_io = false;
+    }
+
+    if(options.resume && options.checkpoint_path[0] == '\0') {
+        error(UNKNOWN_OPTION, "Option '--resume' requires '--checkpoint'\n");
+    }
+
+    if(options.batch && options.checkpoint_path[0] != '\0') {
+        error(UNKNOWN_OPTION, "Option '--checkpoint' cannot be used with multiple tables\n");
+    }
+
+    if(options.batch && (options.patch_path[0] != '\0' || options.apply_patch_path[0] != '\0')) {
+        error(UNKNOWN_OPTION, "Options '--patch' and '--apply-patch' cannot be used with multiple tables\n");
+    }
+
+    if(options.batch && options.consistency_mask_path[0] != '\0') {
+        error(UNKNOWN_OPTION, "Option '--consistency-mask' cannot be used with multiple tables\n");
+    }
+
+    if(options.batch && options.n_benchmark_lookups) {
+        error(UNKNOWN_OPTION, "Option '--benchmark' cannot be used with multiple tables\n");
+    }
+
+    if(options.calibrate
+       && (options.batch || options.n_benchmark_lookups || options.n_scan_samples
+           || options.apply_patch_path[0] != '\0')) {
+        error(
+            UNKNOWN_OPTION,
+            "Option '--calibrate' cannot be used with multiple tables, '--benchmark', '--scan', or '--apply-patch'\n"
+        );
+    }
+
+    if(options.n_scan_samples && (options.n_benchmark_lookups || options.apply_patch_path[0] != '\0')) {
+        error(UNKNOWN_OPTION, "Option '--scan' cannot be used with '--benchmark' or '--apply-patch'\n");
+    }
+
+    if(options.apply_patch_path[0] != '\0' && (options.patch_path[0] != '\0' || options.output_mode != OUTPUT_REWRITE)) {
+        error(UNKNOWN_OPTION, "Option '--apply-patch' cannot be used with '--patch', '--copy-through', or '--in-place'\n");
+    }
+
+    if(options.layout == LAYOUT_INTERLEAVED && options.output_mode != OUTPUT_REWRITE) {
+        error(UNKNOWN_OPTION, "Option '--layout interleaved' cannot be used with '--copy-through' or '--in-place'\n");
+    }
+    if(options.output_format == FORMAT_BINARY
+       && (options.layout != LAYOUT_PLANAR || options.reduce_precision || options.output_mode != OUTPUT_REWRITE)) {
+        error(
+            UNKNOWN_OPTION,
+            "Option '--output-format binary' cannot be used with '--layout', '--precision', '--copy-through', or "
+            "'--in-place'\n"
+        );
+    }
+    for(int n = 0; n < options.n_input_tables; n++) {
+        // These read the input file again through HDF5
+        const bool needs_hdf5_input = options.output_mode != OUTPUT_REWRITE || options.patch_path[0] != '\0'
+                                   || options.apply_patch_path[0] != '\0';
+        if(needs_hdf5_input && is_binary_table_file(options.input_table_paths[n])) {
+            error(
+                UNKNOWN_OPTION,
+                "Options '--copy-through', '--in-place', '--patch', and '--apply-patch' need an HDF5 input, but '%s' "
+                "is a binary table\n",
+                options.input_table_paths[n]
+            );
+        }
+        // They also read and write the quantities as planar datasets
+        if(needs_hdf5_input && is_interleaved_table_file(options.input_table_paths[n])) {
+            error(
+                UNKNOWN_OPTION,
+                "Options '--copy-through', '--in-place', '--patch', and '--apply-patch' cannot be used with '%s', which "
+                "has an interleaved layout\n",
+                options.input_table_paths[n]
+            );
+        }
+        // Reduced datasets cannot hold the cleaned f64 values, and patches would compare the raw stored values
+        if(needs_hdf5_input && is_reduced_precision_table_file(options.input_table_paths[n])) {
+            error(
+                UNKNOWN_OPTION,
+                "Options '--copy-through', '--in-place', '--patch', and '--apply-patch' cannot be used with '%s', which "
+                "has reduced precision quantities\n",
+                options.input_table_paths[n]
+            );
+        }
+    }
+    if(options.reduce_precision && (options.layout != LAYOUT_PLANAR || options.output_mode != OUTPUT_REWRITE)) {
+        error(UNKNOWN_OPTION, "Option '--precision' can only be used with the default output mode and layout\n");
+    }
+    if(options.decimate_tolerance > 0 && (options.output_mode != OUTPUT_REWRITE || options.patch_path[0] != '\0')) {
+        error(UNKNOWN_OPTION, "Option '--decimate' cannot be used with '--copy-through', '--in-place', or '--patch'\n");
+    }
+    if(options.n_decimate_qtys == 0) {
+        // Reproduce all quantities by default
+        for(int q = 0; q < number_of_eos_quantities; q++) {
+            options.decimate_qtys[options.n_decimate_qtys++] = q;
+        }
+    }
+    if(options.n_layout_qtys == 0) {
+        // Interleave all quantities by default
+        for(int q = 0; q < number_of_eos_quantities; q++) {
+            options.layout_qtys[options.n_layout_qtys++] = q;
         }
-        snprintf(options.output_table_path, 1034, "%s_clean.h5", options.input_table_path);
-        *dot = '.';
     }
 
-    info("Input table path  : %s\n", options.input_table_path);
-    info("Output table path : %s\n", options.output_table_path);
+    snprintf(options.input_table_path, 1024, "%s", options.input_table_paths[0]);
+    if(options.output_mode == OUTPUT_IN_PLACE) {
+        snprintf(options.output_table_path, 1034, "%s", options.input_table_path);
+    }
+    else if(options.output_table_path[0] == '\0') {
+        // User didn't provide an output table path. Set it to default.
+        set_default_output_path(&options, options.input_table_path, options.output_table_path, 1034);
+    }
+
+    if(options.calibrate) {
+        // Calibration writes only the execution profile
+        info("Input table path  : %s\n", options.input_table_path);
+        info(
+            "Profile directory : %s\n",
+            options.profile_dir[0] != '\0' ? options.profile_dir : "~/" PROFILE_DIR_DEFAULT
+        );
+        return options;
+    }
+    if(options.n_scan_samples) {
+        // Scans write no output
+        info("Input tables      : %d\n", options.n_input_tables);
+        info("Scan              : %" PRIu64 " samples per quantity\n", options.n_scan_samples);
+        return options;
+    }
+    if(options.batch) {
+        info("Input tables      : %d\n", options.n_input_tables);
+        info("Output directory  : %s\n", options.output_dir[0] != '\0' ? options.output_dir : ".");
+        info("Overlap I/O       : %s\n", options.overlap_io ? "yes" : "no");
+    }
+    else {
+        info("Input table path  : %s\n", options.input_table_path);
+        info("Output table path : %s\n", options.output_table_path);
+        if(options.patch_path[0] != '\0') {
+            info("Patch path        : %s\n", options.patch_path);
+        }
+    }
+    if(options.apply_patch_path[0] != '\0') {
+        info("Applying patch    : %s\n", options.apply_patch_path);
+        return options;
+    }
+    if(options.n_benchmark_lookups) {
+        info("Lookup benchmark  : %" PRIu64 " lookups\n", options.n_benchmark_lookups);
+        return options;
+    }
+    info("Output mode       : %s\n", output_mode_to_str(options.output_mode));
+    if(options.output_format == FORMAT_BINARY) {
+        info("Output format     : binary\n");
+    }
+    if(options.cache_dir[0] != '\0') {
+        info("Cache directory   : %s\n", options.cache_dir);
+    }
+    if(options.use_roi) {
+        info(
+            "Region of interest: rho [%g, %g] g/cm^3, T [%g, %g] MeV, Ye [%g, %g]\n",
+            options.roi_min[0],
+            options.roi_max[0],
+            options.roi_min[1],
+            options.roi_max[1],
+            options.roi_min[2],
+            options.roi_max[2]
+        );
+    }
+    if(options.median_single_precision) {
+        info("Median precision  : f32 (outliers and borderline points rechecked in f64)\n");
+    }
+    if(options.check_consistency) {
+        info(
+            "Consistency check : yes%s%s\n",
+            options.consistency_mask_path[0] != '\0' ? ", mask written to " : "",
+            options.consistency_mask_path
+        );
+    }
+    if(options.checkpoint_path[0] != '\0') {
+        info("Checkpoint        : %s%s\n", options.checkpoint_path, options.resume ? " (resuming)" : "");
+    }
+    if(options.layout == LAYOUT_INTERLEAVED) {
+        info(
+            "Output layout     : interleaved (%d quantities%s, tile size %d)\n",
+            options.n_layout_qtys,
+            options.layout_pad ? ", padded to cache lines" : "",
+            options.layout_tile
+        );
+    }
+    for(int q = 0; q < number_of_eos_quantities; q++) {
+        if(options.precision[q].type != PRECISION_F64) {
+            char spec[64];
+            precision_spec_to_str(&options.precision[q], spec, sizeof(spec));
+            info("Precision         : %s (%s)\n", stellar_collapse_qty_to_str(q), spec);
+        }
+    }
+    if(options.decimate_tolerance > 0) {
+        info("Decimation        : tolerance %g (%d quantities)\n", options.decimate_tolerance, options.n_decimate_qtys);
+    }
     info("Smoothing option  : %s\n", smoother_to_str(options.smoother));
     info("Derivative option : %s\n", derivs_to_str(options.derivs));
 
     return options;
 }
+
+void
+free_cmd_args(options_t *options)
+{
+    for(int n = 0; n < options->n_input_tables; n++) {
+        free(options->input_table_paths[n]);
+    }
+    free(options->input_table_paths);
+    options->input_table_paths = NULL;
+    options->n_input_tables    = 0;
+}
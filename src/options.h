@@ -1,6 +1,12 @@
 #ifndef OPTIONS_H
 #define OPTIONS_H
 
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "precision.h"
+#include "stellar_collapse_eos.h"
+
 typedef enum
 {
     SMOOTH_INVALID = -1,
@@ -18,14 +24,69 @@ typedef enum
     DERIVS_DO_NOTHING,
 } derivs_t;
 
+typedef enum
+{
+    OUTPUT_REWRITE,
+    OUTPUT_COPY_THROUGH,
+    OUTPUT_IN_PLACE,
+} output_mode_t;
+
+typedef enum
+{
+    LAYOUT_PLANAR,
+    LAYOUT_INTERLEAVED,
+} layout_t;
+
+typedef enum
+{
+    FORMAT_HDF5,
+    FORMAT_BINARY,
+} output_format_t;
+
 typedef struct
 {
-    char       input_table_path[1024];
-    char       output_table_path[1034];
-    smoother_t smoother;
-    derivs_t   derivs;
+    char                          input_table_path[1024];
+    char                          output_table_path[1034];
+    char                          output_dir[1024];
+    char                          patch_path[1024];
+    char                          apply_patch_path[1024];
+    char                          cache_dir[1024];
+    char                          checkpoint_path[1024];
+    char                          consistency_mask_path[1024];
+    char                          profile_dir[1024];
+    bool                          resume;
+    char                        **input_table_paths;
+    int                           n_input_tables;
+    bool                          batch;
+    bool                          overlap_io;
+    output_mode_t                 output_mode;
+    output_format_t               output_format;
+    layout_t                      layout;
+    bool                          layout_pad;
+    int                           layout_tile;
+    int                           n_layout_qtys;
+    stellar_collapse_eos_quantity layout_qtys[number_of_eos_quantities];
+    u64                           n_benchmark_lookups;
+    u64                           n_scan_samples;
+    bool                          calibrate;
+    bool                          check_consistency;
+    bool                          median_single_precision;
+    bool                          use_roi;
+    f64                           roi_min[3];
+    f64                           roi_max[3];
+    bool                          reduce_precision;
+    f64                           decimate_tolerance;
+    int                           n_decimate_qtys;
+    stellar_collapse_eos_quantity decimate_qtys[number_of_eos_quantities];
+    precision_spec                precision[number_of_eos_quantities];
+    smoother_t                    smoother;
+    derivs_t                      derivs;
 } options_t;
 
 options_t parse_cmd_args(int argc, char **argv);
 
+void free_cmd_args(options_t *options);
+
+void set_default_output_path(const options_t *opts, const char *input_path, char *output_path, const int size);
+
 #endif // OPTIONS_H
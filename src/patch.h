@@ -0,0 +1,41 @@
+/**
+ * @file patch.h
+ * @author Leo Werneck
+ *
+ * @brief Sparse patches holding only the points changed by the cleaner.
+ *
+ * A patch is an HDF5 file with the table dimensions ("pointsrho", "pointstemp", "pointsye") and, for each quantity
+ * with changes, a group named after the quantity containing the sorted linear indices ("indices", u64) of the changed
+ * points and their new values ("values", f64). Each group has a "source_hash" attribute (u64) with the parallel_hash
+ * of the original dataset, so that the patch is only applied to the table it was created from.
+ */
+#ifndef PATCH_H
+#define PATCH_H
+
+#include "stellar_collapse_eos.h"
+
+/**
+ * @brief Writes a patch with the points of a table that differ from the file it was read from.
+ *
+ * Only the Ye planes of each quantity modified since the table was read are compared.
+ *
+ * @param table Pointer to the cleaned stellar_collapse_eos structure.
+ * @param original_filepath Path to the EOS table file the table was read from.
+ * @param patch_filepath Path to the patch file to write.
+ */
+void write_table_patch(const stellar_collapse_eos *table, const char *original_filepath, const char *patch_filepath);
+
+/**
+ * @brief Applies a patch to an EOS table file, writing the result to a new file.
+ *
+ * The input is streamed one dataset at a time: patched quantities are read, updated, and written, while every other
+ * object is copied without being decoded. A patched quantity whose dataset does not match the source hash of the patch
+ * is refused.
+ *
+ * @param input_filepath Path to the original EOS table file.
+ * @param patch_filepath Path to the patch file.
+ * @param output_filepath Path to the patched EOS table file.
+ */
+void apply_table_patch(const char *input_filepath, const char *patch_filepath, const char *output_filepath);
+
+#endif // PATCH_H
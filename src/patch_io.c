@@ -0,0 +1,301 @@
+#include <hdf5.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include "hash.h"
+#include "hdf5_helpers.h"
+#include "patch.h"
+#include "utils.h"
+
+static inline bool
+values_differ(const f64 a, const f64 b)
+{
+    return !(a == b) && !(isnan(a) && isnan(b));
+}
+
+/**
+ * @brief Collects the sorted indices and new values of the points where two arrays differ.
+ *
+ * Each thread counts the changes in its contiguous chunk, the counts are turned into offsets, and each thread then
+ * fills its own part of the output, so the indices come out sorted without a sort.
+ */
+static u64
+collect_changed_points(
+    const u64  n_points,
+    const u64  index_offset,
+    const f64 *original,
+    const f64 *clean,
+    u64      **indices,
+    f64      **values
+)
+{
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = omp_get_max_threads();
+#endif
+    u64 *offsets = malloc_or_error(sizeof(u64) * (n_threads + 1));
+    u64 *idx     = NULL;
+    f64 *val     = NULL;
+    int  team    = 1;
+
+#ifdef _OPENMP
+#    pragma omp parallel num_threads(n_threads)
+#endif
+    {
+        int tid = 0, nth = 1;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+        nth = omp_get_num_threads();
+#endif
+        const u64 begin = n_points * tid / nth;
+        const u64 end   = n_points * (tid + 1) / nth;
+
+        u64 count = 0;
+        for(u64 i = begin; i < end; i++) {
+            count += values_differ(original[i], clean[i]);
+        }
+        offsets[tid + 1] = count;
+
+#ifdef _OPENMP
+#    pragma omp barrier
+#    pragma omp single
+#endif
+        {
+            team       = nth;
+            offsets[0] = 0;
+            for(int t = 0; t < nth; t++) {
+                offsets[t + 1] += offsets[t];
+            }
+            idx = malloc_or_error(sizeof(u64) * (offsets[nth] ? offsets[nth] : 1));
+            val = malloc_or_error(sizeof(f64) * (offsets[nth] ? offsets[nth] : 1));
+        }
+
+        u64 k = offsets[tid];
+        for(u64 i = begin; i < end; i++) {
+            if(values_differ(original[i], clean[i])) {
+                idx[k]   = index_offset + i;
+                val[k++] = clean[i];
+            }
+        }
+    }
+
+    const u64 n_changed = offsets[team];
+    free(offsets);
+
+    *indices = idx;
+    *values  = val;
+    return n_changed;
+}
+
+void
+write_table_patch(const stellar_collapse_eos *table, const char *original_filepath, const char *patch_filepath)
+{
+    hid_t original_id = H5Fopen(original_filepath, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(original_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", original_filepath);
+    }
+
+    hid_t patch_id = H5Fcreate(patch_filepath, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if(patch_id < 0) {
+        H5Fclose(original_id);
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", patch_filepath);
+    }
+
+    const hsize_t one = 1;
+    write_hdf5_dataset(patch_id, I32, 1, &one, &table->n_rho, "pointsrho");
+    write_hdf5_dataset(patch_id, I32, 1, &one, &table->n_temperature, "pointstemp");
+    write_hdf5_dataset(patch_id, I32, 1, &one, &table->n_ye, "pointsye");
+
+    const u64 plane_size = (u64)table->n_rho * table->n_temperature;
+    u64       n_total    = 0;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!is_quantity_modified(table, n)) {
+            continue;
+        }
+
+        // Only the modified Ye planes can differ from the original table
+        const i32     begin     = table->modified_ye_begin[n];
+        const i32     end       = table->modified_ye_end[n];
+        const hsize_t offset[3] = {begin, 0, 0};
+        const hsize_t count[3]  = {end - begin, table->n_temperature, table->n_rho};
+        const u64     n_points  = plane_size * (end - begin);
+        const char   *name      = stellar_collapse_qty_to_str(n);
+
+        f64 *original = malloc_or_error(sizeof(f64) * n_points);
+        read_hdf5_dataset_hyperslab(original_id, F64, name, offset, count, original);
+
+        u64      *indices   = NULL;
+        f64      *values    = NULL;
+        const u64 n_changed = collect_changed_points(
+            n_points,
+            begin * plane_size,
+            original,
+            table->data[n] + begin * plane_size,
+            &indices,
+            &values
+        );
+        free(original);
+
+        if(n_changed) {
+            const hsize_t size     = n_changed;
+            hid_t         group_id = H5Gcreate(patch_id, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+            if(group_id < 0) {
+                error(HDF5_DATASET_CREATE_FAILED, "Failed to create group '%s'.\n", name);
+            }
+            write_hdf5_dataset(group_id, U64, 1, &size, indices, "indices");
+            write_hdf5_dataset(group_id, F64, 1, &size, values, "values");
+
+            // Ties the patch to the table it was made from, not just to a table with the same dimensions
+            f64      *source      = read_hdf5_dataset(original_id, F64, name);
+            const u64 source_hash = parallel_hash(source, sizeof(f64) * plane_size * table->n_ye, 0);
+            write_hdf5_attribute(group_id, U64, "source_hash", &source_hash);
+            free(source);
+            H5Gclose(group_id);
+        }
+        info("  %-9s: %" PRIu64 " points in patch\n", name, n_changed);
+        n_total += n_changed;
+
+        free(indices);
+        free(values);
+    }
+
+    H5Fclose(patch_id);
+    H5Fclose(original_id);
+
+    info(
+        "Patch has %" PRIu64 " points (%.3g%% of the table)\n",
+        n_total,
+        100.0 * n_total / ((f64)plane_size * table->n_ye * number_of_eos_quantities)
+    );
+}
+
+typedef struct
+{
+    hid_t patch_id;
+    hid_t output_id;
+    u64   size;
+    i32   n_rho, n_temperature, n_ye;
+    char  mismatch[64]; ///< Quantity whose dataset does not match the source hash of the patch, if any.
+} apply_patch_context;
+
+static herr_t
+apply_patch_to_object(hid_t input_id, const char *name, const H5L_info_t *link_info, void *data)
+{
+    (void)link_info;
+    apply_patch_context                *ctx = (apply_patch_context *)data;
+    const stellar_collapse_eos_quantity qty = stellar_collapse_qty_from_str(name);
+
+    if(qty == number_of_eos_quantities || H5Lexists(ctx->patch_id, name, H5P_DEFAULT) <= 0) {
+        if(H5Ocopy(input_id, name, ctx->output_id, name, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+            error(HDF5_DATASET_WRITE_FAILED, "Could not copy object '%s'.\n", name);
+        }
+        return 0;
+    }
+
+    char indices_name[64], values_name[64];
+    snprintf(indices_name, sizeof(indices_name), "%s/indices", name);
+    snprintf(values_name, sizeof(values_name), "%s/values", name);
+
+    const u64 n_changed = get_hdf5_dataset_size(ctx->patch_id, indices_name);
+    f64      *table     = read_hdf5_dataset(input_id, F64, name);
+    u64      *indices   = read_hdf5_dataset(ctx->patch_id, U64, indices_name);
+    f64      *values    = read_hdf5_dataset(ctx->patch_id, F64, values_name);
+
+    // The patch only holds the changed points, so applying it to another table would mix the two
+    u64   source_hash = 0;
+    hid_t group_id    = H5Gopen(ctx->patch_id, name, H5P_DEFAULT);
+    if(group_id < 0 || !read_hdf5_attribute(group_id, U64, "source_hash", &source_hash)
+       || source_hash != parallel_hash(table, sizeof(f64) * ctx->size, 0)) {
+        snprintf(ctx->mismatch, sizeof(ctx->mismatch), "%s", name);
+        H5Gclose(group_id);
+        free(table);
+        free(indices);
+        free(values);
+        return 1; // Stops the iteration, so the files can be closed before the error
+    }
+    H5Gclose(group_id);
+
+    u64 out_of_range = 0;
+#ifdef _OPENMP
+#    pragma omp parallel for reduction(+ : out_of_range)
+#endif
+    for(u64 i = 0; i < n_changed; i++) {
+        if(indices[i] < ctx->size) {
+            table[indices[i]] = values[i];
+        }
+        else {
+            out_of_range++;
+        }
+    }
+    if(out_of_range) {
+        error(INVALID_ARGUMENT, "Patch for '%s' has %" PRIu64 " indices out of range.\n", name, out_of_range);
+    }
+
+    const hsize_t dims[3] = {ctx->n_ye, ctx->n_temperature, ctx->n_rho};
+    write_hdf5_dataset(ctx->output_id, F64, 3, dims, table, name);
+    info("  %-9s: %" PRIu64 " points patched\n", name, n_changed);
+
+    free(table);
+    free(indices);
+    free(values);
+    return 0;
+}
+
+void
+apply_table_patch(const char *input_filepath, const char *patch_filepath, const char *output_filepath)
+{
+    hid_t input_id = H5Fopen(input_filepath, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(input_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", input_filepath);
+    }
+    hid_t patch_id = H5Fopen(patch_filepath, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if(patch_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", patch_filepath);
+    }
+
+    // The patch must have been created from a table with the same dimensions
+    const char *dim_names[3] = {"pointsrho", "pointstemp", "pointsye"};
+    i32         dims[3];
+    for(int d = 0; d < 3; d++) {
+        i32 *input_dim = read_hdf5_dataset(input_id, I32, dim_names[d]);
+        i32 *patch_dim = read_hdf5_dataset(patch_id, I32, dim_names[d]);
+        if(*input_dim != *patch_dim) {
+            error(INVALID_ARGUMENT, "Patch has %s = %d, but table has %d\n", dim_names[d], *patch_dim, *input_dim);
+        }
+        dims[d] = *input_dim;
+        free(input_dim);
+        free(patch_dim);
+    }
+
+    hid_t output_id = H5Fcreate(output_filepath, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if(output_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", output_filepath);
+    }
+
+    copy_hdf5_attributes(input_id, output_id);
+
+    apply_patch_context ctx = {patch_id, output_id, (u64)dims[0] * dims[1] * dims[2], dims[0], dims[1], dims[2], ""};
+    H5Literate(input_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, apply_patch_to_object, &ctx);
+
+    H5Fclose(output_id);
+    H5Fclose(patch_id);
+    H5Fclose(input_id);
+
+    if(ctx.mismatch[0] != '\0') {
+        remove(output_filepath);
+        error(
+            INVALID_ARGUMENT,
+            "Patch '%s' was not created from '%s' (dataset '%s' does not match)\n",
+            patch_filepath,
+            input_filepath,
+            ctx.mismatch
+        );
+    }
+}
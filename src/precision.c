@@ -0,0 +1,164 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "precision.h"
+#include "utils.h"
+
+void
+parse_precision_spec(const char *arg, precision_spec *specs)
+{
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "%s", arg);
+
+    char *type = strchr(buffer, '=');
+    if(!type) {
+        error(UNKNOWN_OPTION, "Precision option '%s' must have the form <qty>=<type>[:abs=<bound>|:rel=<bound>]\n", arg);
+    }
+    *type++ = '\0';
+
+    const stellar_collapse_eos_quantity qty = stellar_collapse_qty_from_str(buffer);
+    if(qty == number_of_eos_quantities) {
+        error(UNKNOWN_OPTION, "Unknown quantity '%s'\n", buffer);
+    }
+
+    precision_spec spec = {PRECISION_F64, false, 0};
+    char          *kind = strchr(type, ':');
+    if(kind) {
+        *kind++ = '\0';
+        if(!strncmp(kind, "abs=", 4) || !strncmp(kind, "rel=", 4)) {
+            spec.relative = kind[0] == 'r';
+            spec.bound    = atof(kind + 4);
+        }
+        if(spec.bound <= 0) {
+            error(UNKNOWN_OPTION, "Invalid error bound '%s' (expected abs=<bound> or rel=<bound>)\n", kind);
+        }
+    }
+
+    if(!strcmp(type, "f64")) {
+        spec.type = PRECISION_F64;
+    }
+    else if(!strcmp(type, "f32")) {
+        spec.type = PRECISION_F32;
+    }
+    else if(!strcmp(type, "quant")) {
+        spec.type = PRECISION_QUANTIZED;
+        if(!kind) {
+            error(UNKNOWN_OPTION, "Quantized quantity '%s' needs an error bound\n", buffer);
+        }
+    }
+    else {
+        error(UNKNOWN_OPTION, "Unknown precision '%s' (expected f64, f32, or quant)\n", type);
+    }
+
+    specs[qty] = spec;
+}
+
+const char *
+precision_spec_to_str(const precision_spec *spec, char *str, const usize size)
+{
+    const char *types[3] = {"f64", "f32", "quant"};
+    if(spec->bound > 0) {
+        snprintf(str, size, "%s, %s %g", types[spec->type], spec->relative ? "rel" : "abs", spec->bound);
+    }
+    else {
+        snprintf(str, size, "%s", types[spec->type]);
+    }
+    return str;
+}
+
+static inline f64
+point_error(const f64 x, const f64 y, const bool relative)
+{
+    if(x == y || (isnan(x) && isnan(y))) {
+        return 0;
+    }
+    const f64 err = fabs(x - y);
+    return relative ? err / fabs(x) : err;
+}
+
+u64
+convert_to_f32(const f64 *data, const u64 size, const precision_spec *spec, f32 *out, f64 *max_error)
+{
+    // Without a bound f32 is accepted as is, but the error is still reported
+    const f64 bound      = spec->bound > 0 ? spec->bound : INFINITY;
+    u64       violations = 0;
+    f64       max_err    = 0;
+
+#ifdef _OPENMP
+#    pragma omp parallel for reduction(+ : violations) reduction(max : max_err)
+#endif
+    for(u64 i = 0; i < size; i++) {
+        out[i]        = (f32)data[i];
+        const f64 err = point_error(data[i], out[i], spec->relative);
+        violations   += !(err <= bound);
+        max_err       = err > max_err ? err : max_err;
+    }
+
+    *max_error = max_err;
+    return violations;
+}
+
+u64
+quantize(const f64 *data, const u64 size, const precision_spec *spec, quantization *q, u32 *out, f64 *max_error)
+{
+    f64 min = INFINITY, max = -INFINITY, min_abs = INFINITY;
+#ifdef _OPENMP
+#    pragma omp parallel for reduction(min : min, min_abs) reduction(max : max)
+#endif
+    for(u64 i = 0; i < size; i++) {
+        min     = data[i] < min ? data[i] : min;
+        max     = data[i] > max ? data[i] : max;
+        min_abs = fabs(data[i]) < min_abs ? fabs(data[i]) : min_abs;
+    }
+
+    // Rounding to the nearest level has an error of at most half the spacing, so the spacing can be twice the bound
+    // (with a small margin for rounding). A relative bound is met everywhere if it is met for the smallest magnitude.
+    const f64 abs_bound = spec->relative ? spec->bound * min_abs : spec->bound;
+    const f64 range     = max - min;
+    if(!isfinite(range) || abs_bound <= 0) {
+        q->bits = 0;
+        warn("Cannot quantize a quantity with %s\n", isfinite(range) ? "zeros and a relative bound" : "non-finite values");
+        *max_error = INFINITY;
+        return size;
+    }
+
+    const f64 levels = ceil(range / (1.999 * abs_bound));
+    i32       bits   = 1;
+    while(bits < QUANTIZATION_MAX_BITS && ldexp(1.0, bits) - 1 < levels) {
+        bits++;
+    }
+    q->bits   = bits;
+    q->offset = min;
+    q->scale  = range > 0 ? range / (ldexp(1.0, bits) - 1) : 1;
+
+    const f64 max_level  = ldexp(1.0, bits) - 1;
+    u64       violations = 0;
+    f64       max_err    = 0;
+#ifdef _OPENMP
+#    pragma omp parallel for reduction(+ : violations) reduction(max : max_err)
+#endif
+    for(u64 i = 0; i < size; i++) {
+        f64 level     = round((data[i] - q->offset) / q->scale);
+        level         = level < 0 ? 0 : (level > max_level ? max_level : level);
+        out[i]        = (u32)level;
+        const f64 err = point_error(data[i], q->offset + q->scale * out[i], spec->relative);
+        violations   += !(err <= spec->bound);
+        max_err       = err > max_err ? err : max_err;
+    }
+
+    *max_error = max_err;
+    return violations;
+}
+
+void
+dequantize(const quantization *q, const u64 size, f64 *data)
+{
+#ifdef _OPENMP
+#    pragma omp parallel for
+#endif
+    for(u64 i = 0; i < size; i++) {
+        data[i] = q->offset + q->scale * data[i];
+    }
+}
@@ -0,0 +1,122 @@
+/**
+ * @file precision.h
+ * @author Leo Werneck
+ *
+ * @brief Error-bounded precision reduction of EOS quantities for output.
+ *
+ * A quantity can be stored as f32 or quantized: its values are mapped to evenly spaced integer levels between the
+ * minimum and the maximum (x = offset + scale * q), using the smallest number of bits that meets the error bound and
+ * the smallest unsigned integer type that holds them. Bounds are absolute or relative to each value, and are checked
+ * for every point before anything is written.
+ */
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <stdbool.h>
+
+#include "basic_types.h"
+#include "stellar_collapse_eos.h"
+
+#define QUANTIZATION_MAX_BITS (32)
+
+typedef enum
+{
+    PRECISION_F64,
+    PRECISION_F32,
+    PRECISION_QUANTIZED,
+} precision_t;
+
+/**
+ * @brief How a quantity is stored and the error allowed.
+ */
+typedef struct
+{
+    precision_t type;     ///< Storage type.
+    bool        relative; ///< If true, the bound is relative to each value; otherwise it is absolute.
+    f64         bound;    ///< Largest error allowed.
+} precision_spec;
+
+/**
+ * @brief Parameters of a quantized quantity.
+ */
+typedef struct
+{
+    i32 bits;   ///< Number of bits per value.
+    f64 offset; ///< Value of level 0.
+    f64 scale;  ///< Spacing between levels.
+} quantization;
+
+/**
+ * @brief Parses a precision option of the form <qty>=<type>[:abs=<bound>|:rel=<bound>] (e.g., "Xa=f32:rel=1e-6").
+ *
+ * The type is f64, f32, or quant; quantized quantities require a bound.
+ *
+ * @param arg The option to parse.
+ * @param specs Array of number_of_eos_quantities specifications; the one of the quantity is set.
+ */
+void parse_precision_spec(const char *arg, precision_spec *specs);
+
+/**
+ * @brief Returns a short description of a specification (e.g., "f32, rel 1e-06").
+ */
+const char *precision_spec_to_str(const precision_spec *spec, char *str, usize size);
+
+/**
+ * @brief Converts a quantity to f32 and checks the error bound.
+ *
+ * @param data The values of the quantity.
+ * @param size The number of values.
+ * @param spec The precision specification.
+ * @param out The converted values.
+ * @param max_error Largest error found (relative if the bound is relative).
+ *
+ * @return The number of values whose error exceeds the bound.
+ */
+u64 convert_to_f32(const f64 *data, u64 size, const precision_spec *spec, f32 *out, f64 *max_error);
+
+/**
+ * @brief Quantizes a quantity with the fewest bits that meet the error bound and checks it.
+ *
+ * @param data The values of the quantity.
+ * @param size The number of values.
+ * @param spec The precision specification.
+ * @param q The quantization parameters.
+ * @param out The quantized levels.
+ * @param max_error Largest error found (relative if the bound is relative).
+ *
+ * @return The number of values whose error exceeds the bound (including values that are not finite).
+ */
+u64 quantize(const f64 *data, u64 size, const precision_spec *spec, quantization *q, u32 *out, f64 *max_error);
+
+/**
+ * @brief Converts quantized levels (stored as f64) back to values in place.
+ */
+void dequantize(const quantization *q, u64 size, f64 *data);
+
+/**
+ * @brief Writes a stellar collapse EOS table with the precision of each quantity given by a specification.
+ *
+ * Quantized datasets have the attributes "quantization_bits", "quantization_offset", and "quantization_scale", which
+ * read_stellar_collapse_eos_table uses to restore the values; f32 datasets are converted by HDF5 when read. Nothing
+ * is written if any bound is not met.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to write.
+ * @param specs Array of number_of_eos_quantities specifications.
+ * @param filepath Path to the output EOS table file (HDF5 format).
+ */
+void write_stellar_collapse_eos_table_reduced(
+    const stellar_collapse_eos *table,
+    const precision_spec       *specs,
+    const char                 *filepath
+);
+
+/**
+ * @brief Returns whether an HDF5 file holds a table with quantities stored as f32 or quantized.
+ *
+ * Files that cannot be opened as HDF5 are reported as not reduced, so that reading them reports the error.
+ *
+ * @param filepath Path to the file.
+ */
+bool is_reduced_precision_table_file(const char *filepath);
+
+#endif // PRECISION_H
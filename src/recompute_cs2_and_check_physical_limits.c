@@ -1,71 +1,173 @@
 #include <float.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdbool.h>
 
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
 #include "basic_types.h"
+#include "execution_profile.h"
 #include "stellar_collapse_eos.h"
 #include "utils.h"
 
-#define INDEX(ir, it, iy) ((ir) + table->n_rho * ((it) + table->n_temperature * (iy)))
+#define INDEX(ir, it, iy) ((u64)(ir) + (u64)table->n_rho * ((u64)(it) + (u64)table->n_temperature * (u64)(iy)))
+
+static inline void
+recompute_cs2_at_point(
+    stellar_collapse_eos *table,
+    const i64             ir,
+    const i64             it,
+    const i64             iy,
+    u64                  *negative_cs2_count,
+    u64                  *superluminal_cs2_count,
+    i64                  *modified_ye_begin,
+    i64                  *modified_ye_end
+)
+{
+    const u64 index    = INDEX(ir, it, iy);
+    const f64 rho      = pow(10.0, table->log10_rho[ir]);
+    const f64 press    = pow(10.0, table->data[eos_logpress][index]);
+    const f64 eps      = pow(10.0, table->data[eos_logenergy][index]) - table->energy_shift;
+    const f64 dPdrho_e = table->data[eos_dpdrhoe][index];
+    const f64 dPde_rho = table->data[eos_dpderho][index];
+
+    // assume table is hardened
+    f64 bulk_modulus = rho * dPdrho_e + (press / rho) * dPde_rho;
+    if(bulk_modulus < DBL_EPSILON) {
+        bulk_modulus = DBL_EPSILON;
+    }
+
+    // Recompute cs2 and check physical bounds
+    const f64 h = SPEED_OF_LIGHT_SQUARED_CGS + eps + press / rho;
+    const f64 w = rho * h;
+    f64 cs2_new = SPEED_OF_LIGHT_SQUARED_CGS * bulk_modulus / w;
+
+    if(cs2_new < 0) {
+        (*negative_cs2_count)++;
+    }
+
+    // Compute the enthalpy
+    if(cs2_new > SPEED_OF_LIGHT_SQUARED_CGS) {
+        (*superluminal_cs2_count)++;
+    }
+
+    if(cs2_new != table->data[eos_cs2][index]) {
+        *modified_ye_begin = iy < *modified_ye_begin ? iy : *modified_ye_begin;
+        *modified_ye_end   = iy + 1 > *modified_ye_end ? iy + 1 : *modified_ye_end;
+    }
+
+    table->data[eos_cs2][index] = cs2_new;
+}
 
 void
 recompute_cs2_and_check_physical_limits(stellar_collapse_eos *table)
 {
+    const index_box_t box = {
+        {0,            0,                    0          },
+        {table->n_rho, table->n_temperature, table->n_ye},
+    };
+    recompute_cs2_and_check_physical_limits_in_box(table, &box);
+}
+
+void
+recompute_cs2_and_check_physical_limits_in_box(stellar_collapse_eos *table, const index_box_t *box)
+{
+    const cs2_limits_report report = recompute_cs2_in_box(table, box);
+    print_cs2_limits_report(&report);
+}
+
+cs2_limits_report
+recompute_cs2_in_box(stellar_collapse_eos *table, const index_box_t *box)
+{
+    const i64 ir_min = box->lo[0], ir_max = box->hi[0];
+    const i64 it_min = box->lo[1], it_max = box->hi[1];
+    const i64 iy_min = box->lo[2], iy_max = box->hi[2];
+    const u64 size   = ir_max > ir_min && it_max > it_min && iy_max > iy_min
+                         ? (u64)(ir_max - ir_min) * (it_max - it_min) * (iy_max - iy_min)
+                         : 0;
 
-    i32 negative_cs2_count     = 0;
-    i32 superluminal_cs2_count = 0;
+    u64 negative_cs2_count     = 0;
+    u64 superluminal_cs2_count = 0;
+    i64 modified_ye_begin      = table->n_ye;
+    i64 modified_ye_end        = 0;
 
+    // Threads, schedule, and collapsed loops come from the execution profile
+    const execution_profile *profile   = get_execution_profile();
+    int                      n_threads = 1;
 #ifdef _OPENMP
-#    pragma omp parallel for collapse(3) reduction(+: negative_cs2_count, superluminal_cs2_count)
+    n_threads = profile->cs2_threads > 0 ? profile->cs2_threads : omp_get_max_threads();
 #endif
-    for(i32 iy = 0; iy < table->n_ye; iy++) {
-        for(i32 it = 0; it < table->n_temperature; it++) {
-            for(i32 ir = 0; ir < table->n_rho; ir++) {
-                const u64 index    = INDEX(ir, it, iy);
-                const f64 rho      = pow(10.0, table->log10_rho[ir]);
-                const f64 press    = pow(10.0, table->data[eos_logpress][index]);
-                const f64 eps      = pow(10.0, table->data[eos_logenergy][index]) - table->energy_shift;
-                const f64 dPdrho_e = table->data[eos_dpdrhoe][index];
-                const f64 dPde_rho = table->data[eos_dpderho][index];
-
-                // assume table is hardened
-                f64 bulk_modulus = rho * dPdrho_e + (press / rho) * dPde_rho;
-                if(bulk_modulus < DBL_EPSILON) {
-                    bulk_modulus = DBL_EPSILON;
-                }
-
-                // Recompute cs2 and check physical bounds
-                const f64 h = SPEED_OF_LIGHT_SQUARED_CGS + eps + press / rho;
-                const f64 w = rho * h;
-                f64 cs2_new = SPEED_OF_LIGHT_SQUARED_CGS * bulk_modulus / w;
+    set_runtime_schedule(profile->cs2_schedule);
 
-                if(cs2_new < 0) {
-                    negative_cs2_count++;
+    if(profile->cs2_collapse == 2) {
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(2) schedule(runtime) num_threads(n_threads) \
+        reduction(+: negative_cs2_count, superluminal_cs2_count) \
+        reduction(min: modified_ye_begin) reduction(max: modified_ye_end)
+#endif
+        for(i64 iy = iy_min; iy < iy_max; iy++) {
+            for(i64 it = it_min; it < it_max; it++) {
+                for(i64 ir = ir_min; ir < ir_max; ir++) {
+                    recompute_cs2_at_point(
+                        table,
+                        ir,
+                        it,
+                        iy,
+                        &negative_cs2_count,
+                        &superluminal_cs2_count,
+                        &modified_ye_begin,
+                        &modified_ye_end
+                    );
                 }
-
-                // Compute the enthalpy
-                if(cs2_new > SPEED_OF_LIGHT_SQUARED_CGS) {
-                    superluminal_cs2_count++;
+            }
+        }
+    }
+    else {
+#ifdef _OPENMP
+#    pragma omp parallel for collapse(3) schedule(runtime) num_threads(n_threads) \
+        reduction(+: negative_cs2_count, superluminal_cs2_count) \
+        reduction(min: modified_ye_begin) reduction(max: modified_ye_end)
+#endif
+        for(i64 iy = iy_min; iy < iy_max; iy++) {
+            for(i64 it = it_min; it < it_max; it++) {
+                for(i64 ir = ir_min; ir < ir_max; ir++) {
+                    recompute_cs2_at_point(
+                        table,
+                        ir,
+                        it,
+                        iy,
+                        &negative_cs2_count,
+                        &superluminal_cs2_count,
+                        &modified_ye_begin,
+                        &modified_ye_end
+                    );
                 }
-
-                table->data[eos_cs2][index] = cs2_new;
             }
         }
     }
-    if(!negative_cs2_count) {
+    mark_ye_planes_modified(table, eos_cs2, modified_ye_begin, modified_ye_end);
+
+    const cs2_limits_report report = {size, negative_cs2_count, superluminal_cs2_count};
+    return report;
+}
+
+void
+print_cs2_limits_report(const cs2_limits_report *report)
+{
+    if(!report->n_negative) {
         info("No points in the table have a negative cs2!\n");
     }
     else {
-        const i32 size = table->n_rho * table->n_temperature * table->n_ye;
-        warn("Found %lu points (~%.1f%%) with negative cs2! Applied ceiling (speed of light).\n",
-             negative_cs2_count, 100.0 * ((double)negative_cs2_count)/((double)size));
+        warn("Found %" PRIu64 " points (~%.1f%%) with negative cs2! Applied ceiling (speed of light).\n",
+             report->n_negative, 100.0 * ((double)report->n_negative)/((double)report->n_points));
     }
-    if(!superluminal_cs2_count) {
+    if(!report->n_superluminal) {
         info("No points in the table have a superluminal cs2!\n");
     }
     else {
-        const i32 size = table->n_rho * table->n_temperature * table->n_ye;
-        warn("Found %lu points (~%.1f%%) with superluminal cs2! Applied ceiling (speed of light).\n",
-             superluminal_cs2_count, 100.0 * ((double)superluminal_cs2_count)/((double)size));
+        warn("Found %" PRIu64 " points (~%.1f%%) with superluminal cs2! Applied ceiling (speed of light).\n",
+             report->n_superluminal, 100.0 * ((double)report->n_superluminal)/((double)report->n_points));
     }
 }
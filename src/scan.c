@@ -0,0 +1,81 @@
+#include <math.h>
+
+#include "median_filter.h"
+#include "scan.h"
+
+// SplitMix64, seeded per stratum so that the sample does not depend on the number of threads
+static u64
+split_mix(u64 z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void
+wilson_interval(const u64 n_flagged, const u64 n_samples, f64 *lower, f64 *upper)
+{
+    const f64 n      = (f64)n_samples;
+    const f64 p      = n_flagged / n;
+    const f64 z2     = SCAN_CONFIDENCE_Z * SCAN_CONFIDENCE_Z;
+    const f64 denom  = 1 + z2 / n;
+    const f64 center = (p + z2 / (2 * n)) / denom;
+    const f64 half   = SCAN_CONFIDENCE_Z / denom * sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+    *lower           = center - half > 0 ? center - half : 0;
+    *upper           = center + half < 1 ? center + half : 1;
+}
+
+outlier_estimate
+estimate_outlier_fraction(
+    const stellar_collapse_eos         *table,
+    const stellar_collapse_eos_quantity qty,
+    const u64                           n_samples,
+    const u64                           seed
+)
+{
+    const u64  nr   = table->n_rho;
+    const u64  nt   = table->n_temperature;
+    const u64  ny   = table->n_ye;
+    const f64 *data = table->data[qty];
+
+    outlier_estimate estimate = {0};
+    if(nr <= 2 * MF_W || nt <= 2 * MF_W || ny <= 2 * MF_W || n_samples == 0) {
+        return estimate;
+    }
+
+    // Interior points, numbered as the table points
+    const u64 mr     = nr - 2 * MF_W;
+    const u64 mt     = nt - 2 * MF_W;
+    const u64 my     = ny - 2 * MF_W;
+    const u64 n_pts  = mr * mt * my;
+    const u64 n      = n_samples < n_pts ? n_samples : n_pts;
+    const f64 stride = (f64)n_pts / n;
+
+    u64 n_flagged = 0;
+#ifdef _OPENMP
+#    pragma omp parallel for schedule(dynamic, 64) reduction(+ : n_flagged)
+#endif
+    for(u64 k = 0; k < n; k++) {
+        const u64 begin = (u64)(k * stride);
+        const u64 end   = k + 1 == n ? n_pts : (u64)((k + 1) * stride);
+        const u64 point = begin + split_mix(seed + k * 0x9E3779B97F4A7C15ULL) % (end - begin);
+        const u64 ir    = MF_W + point % mr;
+        const u64 it    = MF_W + (point / mr) % mt;
+        const u64 iy    = MF_W + point / (mr * mt);
+        f64       median;
+        n_flagged += is_median_filter_outlier(nr, nt, ir, it, iy, data, &median);
+    }
+
+    estimate.n_points  = n_pts;
+    estimate.n_samples = n;
+    estimate.n_flagged = n_flagged;
+    estimate.fraction  = (f64)n_flagged / n;
+    if(n == n_pts) {
+        // Every interior point was checked
+        estimate.lower = estimate.upper = estimate.fraction;
+    }
+    else {
+        wilson_interval(n_flagged, n, &estimate.lower, &estimate.upper);
+    }
+    return estimate;
+}
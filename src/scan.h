@@ -0,0 +1,60 @@
+/**
+ * @file scan.h
+ * @author Leo Werneck
+ *
+ * @brief Fast triage of EOS tables: estimates how many points the median filter would replace from a sample.
+ */
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "basic_types.h"
+#include "options.h"
+#include "stellar_collapse_eos.h"
+
+#define SCAN_CONFIDENCE_Z (1.959963984540054) ///< Normal quantile of the 95% confidence intervals.
+#define SCAN_SEED         (0x5CA11AB1E5EED5ULL) ///< Seed of the sample, so that scans are reproducible.
+
+/**
+ * @brief Estimated fraction of the interior points of a quantity that are outliers.
+ */
+typedef struct
+{
+    u64 n_points;  ///< Number of interior points, i.e., points the median filter may replace.
+    u64 n_samples; ///< Number of points sampled (all interior points if there are fewer than requested).
+    u64 n_flagged; ///< Number of sampled points that are outliers.
+    f64 fraction;  ///< Estimated fraction of outliers.
+    f64 lower;     ///< Lower bound of the 95% (Wilson score) confidence interval of the fraction.
+    f64 upper;     ///< Upper bound of the 95% (Wilson score) confidence interval of the fraction.
+} outlier_estimate;
+
+/**
+ * @brief Estimates the fraction of outliers of a quantity by evaluating the median filter criterion on a sample.
+ *
+ * The interior points are split into n_samples strata of consecutive points, and one point is drawn at random from
+ * each, so the sample covers the whole table. No data is modified.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure containing the table data.
+ * @param qty The quantity to scan.
+ * @param n_samples Number of points to sample.
+ * @param seed Seed of the random number generator.
+ *
+ * @return The estimate of the fraction of outliers.
+ */
+outlier_estimate estimate_outlier_fraction(
+    const stellar_collapse_eos   *table,
+    stellar_collapse_eos_quantity qty,
+    u64                           n_samples,
+    u64                           seed
+);
+
+/**
+ * @brief Scans each input table and reports which tables (and quantities) need cleaning. Writes no output.
+ *
+ * Quantities are selected as for cleaning (see select_quantities_to_filter). Besides the outlier estimates, the
+ * checks of validate_table (NaNs, infinities, and non-monotonic axes) are run on the whole table.
+ *
+ * @param opts Pointer to the options (input tables, number of samples, and smoothing options).
+ */
+void scan_tables(const options_t *opts);
+
+#endif // SCAN_H
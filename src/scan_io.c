@@ -0,0 +1,64 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cleaner.h"
+#include "scan.h"
+#include "utils.h"
+
+static bool
+scan_table(const options_t *opts, const char *path)
+{
+    stellar_collapse_eos *table = read_stellar_collapse_eos_table(path);
+    info("Scanning table '%s' (%" PRIu64 " samples per quantity)\n", path, opts->n_scan_samples);
+
+    // The cleaner's messages would only get in the way of the report
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+    const bool                    info_enabled = set_info_messages_enabled(false);
+    const int                     n_qtys       = select_quantities_to_filter(opts, qtys);
+    const u64                     n_problems   = validate_table(table);
+    set_info_messages_enabled(info_enabled);
+
+    char dirty[256] = "";
+    for(int n = 0; n < n_qtys; n++) {
+        const char            *name     = stellar_collapse_qty_to_str(qtys[n]);
+        const outlier_estimate estimate = estimate_outlier_fraction(table, qtys[n], opts->n_scan_samples, SCAN_SEED);
+        info(
+            "  %-9s: %" PRIu64 " of %" PRIu64
+            " sampled points are outliers, %.4f%% (95%% CI %.4f%% - %.4f%%, up to %.0f points)\n",
+            name,
+            estimate.n_flagged,
+            estimate.n_samples,
+            100 * estimate.fraction,
+            100 * estimate.lower,
+            100 * estimate.upper,
+            estimate.upper * estimate.n_points
+        );
+        if(estimate.n_flagged) {
+            strcat(dirty, dirty[0] != '\0' ? "," : "");
+            strcat(dirty, name);
+        }
+    }
+    info("  NaNs, infinities, and non-monotonic axis points: %" PRIu64 "\n", n_problems);
+    free_stellar_collapse_eos_table(table);
+
+    if(dirty[0] != '\0' || n_problems) {
+        info("Table '%s' needs cleaning (quantities with outliers: %s)\n", path, dirty[0] != '\0' ? dirty : "none");
+        return true;
+    }
+    info("Table '%s' looks clean\n", path);
+    return false;
+}
+
+void
+scan_tables(const options_t *opts)
+{
+    int n_dirty = 0;
+    for(int n = 0; n < opts->n_input_tables; n++) {
+        n_dirty += scan_table(opts, opts->input_table_paths[n]);
+        flush_log();
+    }
+    if(opts->n_input_tables > 1) {
+        info("%d of %d tables need cleaning\n", n_dirty, opts->n_input_tables);
+    }
+}
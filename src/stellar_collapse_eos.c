@@ -1,80 +1,20 @@
-#include <hdf5.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "hdf5_helpers.h"
 #include "stellar_collapse_eos.h"
 #include "utils.h"
 
-static const char *dataset_names[number_of_eos_quantities] = {
-    "Abar",    "Xa",    "Xh",        "Xn",       "Xp",   "Zbar", "cs2",  "dedt",  "dpderho", "dpdrhoe",
-    "entropy", "gamma", "logenergy", "logpress", "mu_e", "mu_n", "mu_p", "muhat", "munu",
-};
-
-stellar_collapse_eos *
-read_stellar_collapse_eos_table(const char *filepath)
-{
-    hid_t file_id = H5Fopen(filepath, H5F_ACC_RDONLY, H5P_DEFAULT);
-    if(file_id < 0) {
-        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
-    }
-
-    stellar_collapse_eos *table = malloc_or_error(sizeof(stellar_collapse_eos));
-
-    // Scalar quantities
-    table->n_rho         = *(i32 *)read_hdf5_dataset(file_id, I32, "pointsrho");
-    table->n_temperature = *(i32 *)read_hdf5_dataset(file_id, I32, "pointstemp");
-    table->n_ye          = *(i32 *)read_hdf5_dataset(file_id, I32, "pointsye");
-    table->energy_shift  = *(f64 *)read_hdf5_dataset(file_id, F64, "energy_shift");
-
-    // Basic tabulated quantities
-    table->ye                = (f64 *)read_hdf5_dataset(file_id, F64, "ye");
-    table->log10_temperature = (f64 *)read_hdf5_dataset(file_id, F64, "logtemp");
-    table->log10_rho         = (f64 *)read_hdf5_dataset(file_id, F64, "logrho");
-
-    // Tabulated data
-    for(u32 n = 0; n < number_of_eos_quantities; n++) {
-        table->data[n] = (f64 *)read_hdf5_dataset(file_id, F64, dataset_names[n]);
-    }
-
-    H5Fclose(file_id);
-
-    return table;
-}
-
-void
-write_stellar_collapse_eos_table(const stellar_collapse_eos *table, const char *filepath)
-{
-    hid_t file_id = H5Fcreate(filepath, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    if(file_id < 0) {
-        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
-    }
-
-    const hsize_t dims[4] = {1, table->n_ye, table->n_temperature, table->n_rho};
-
-    // Scalar quantities
-    write_hdf5_dataset(file_id, I32, 1, dims, &table->n_rho, "pointsrho");
-    write_hdf5_dataset(file_id, I32, 1, dims, &table->n_temperature, "pointstemp");
-    write_hdf5_dataset(file_id, I32, 1, dims, &table->n_ye, "pointsye");
-    write_hdf5_dataset(file_id, F64, 1, dims, &table->energy_shift, "energy_shift");
-
-    // Basic tabulated quantities
-    write_hdf5_dataset(file_id, F64, 1, dims + 1, table->ye, "ye");
-    write_hdf5_dataset(file_id, F64, 1, dims + 2, table->log10_temperature, "logtemp");
-    write_hdf5_dataset(file_id, F64, 1, dims + 3, table->log10_rho, "logrho");
-
-    // Tabulated data
-    for(u32 n = 0; n < number_of_eos_quantities; n++) {
-        write_hdf5_dataset(file_id, F64, 3, dims + 1, table->data[n], dataset_names[n]);
-    }
-}
-
 void
 free_stellar_collapse_eos_table(stellar_collapse_eos *table)
 {
     if(!table) {
         return;
     }
+    free(table->log10_rho);
+    free(table->log10_temperature);
+    free(table->ye);
     for(u32 n = 0; n < number_of_eos_quantities; n++) {
         if(table->data[n]) {
             free(table->data[n]);
@@ -83,92 +23,104 @@ free_stellar_collapse_eos_table(stellar_collapse_eos *table)
     free(table);
 }
 
-#define CHECK_SCALAR(name)                                                            \
-    if(table1->name != table2->name) {                                                \
-        warn("Error in %s: %g != %g\n", #name, (f64)table1->name, (f64)table2->name); \
-    }
-
-void
-ensure_tables_are_equal_or_error(const char *filepath1, const char *filepath2)
-{
-    stellar_collapse_eos *table1 = read_stellar_collapse_eos_table(filepath1);
-    stellar_collapse_eos *table2 = read_stellar_collapse_eos_table(filepath2);
-
-    CHECK_SCALAR(n_rho);
-    CHECK_SCALAR(n_temperature);
-    CHECK_SCALAR(n_ye);
-    CHECK_SCALAR(energy_shift);
-
-    const u32 size             = table1->n_rho * table1->n_temperature * table1->n_ye;
-    bool      all_tests_passed = true;
-    for(u32 n = 0; n < number_of_eos_quantities; n++) {
-        debug("Validating dataset '%-9s'\n", dataset_names[n]);
-        for(u32 i = 0; i < size; i++) {
-            if(table1->data[n][i] != table2->data[n][i]) {
-                warn("Error in %s: %g != %g\n", dataset_names[n], table1->data[n][i], table2->data[n][i]);
-                all_tests_passed = false;
-            }
-        }
-    }
-
-    free_stellar_collapse_eos_table(table1);
-    free_stellar_collapse_eos_table(table2);
-
-    if(all_tests_passed) {
-        info("All tests passed!\n");
-    }
-}
+static const char *axis_names[3] = {"logrho", "logtemp", "ye"};
 
 static u64
-validate_increasing_monotonically(const u64 size, const f64 *data, const char *name)
+count_decreasing_points(const u64 size, const f64 *data, const char *name, const bool warn_each_point)
 {
     u64 count = 0;
-    for(u32 i = 1; i < size; i++) {
+    for(u64 i = 1; i < size; i++) {
         const f64 left  = data[i - 1];
         const f64 right = data[i];
         if(left > right) {
-            warn("%s not increasing monotonically! %g > %g\n", name, left, right);
+            if(warn_each_point) {
+                WARN_RATE_LIMITED("%s not increasing monotonically! %g > %g\n", name, left, right);
+            }
             count++;
         }
     }
-    if(count) {
-        warn("Found %lu problematic points in %lu for %s\n", count, size, name);
-    }
     return count;
 }
 
-#define CHECK_DATASETS_ARE_FINITE(func)                                                            \
-    for(u32 n = 0; n < number_of_eos_quantities; n++) {                                            \
-        const char *name         = dataset_names[n];                                               \
-        u64         local_errors = 0;                                                              \
-        for(u64 i = 0; i < size; i++) {                                                            \
-            if(isnan(table->data[n][i])) {                                                         \
-                warn("Found %s in dataset '%s', index %lu\n", #func, name, i);                     \
-                local_errors++;                                                                    \
-            }                                                                                      \
-        }                                                                                          \
-        if(local_errors) {                                                                         \
-            warn("Dataset '%s' has %lu %ss out of %lu points\n", name, local_errors, #func, size); \
-        }                                                                                          \
-        else {                                                                                     \
-            info("Dataset '%s' does not contain %ss!\n", name, #func);                             \
-        }                                                                                          \
+#define COUNT_NON_FINITE(func, counts)                                                                  \
+    for(u64 n = 0; n < number_of_eos_quantities; n++) {                                                 \
+        const char *name = stellar_collapse_qty_to_str(n);                                              \
+        for(u64 i = 0; i < report.n_points; i++) {                                                      \
+            if(is##func(table->data[n][i])) {                                                           \
+                if(warn_each_point) {                                                                   \
+                    WARN_RATE_LIMITED("Found %s in dataset '%s', index %" PRIu64 "\n", #func, name, i); \
+                }                                                                                       \
+                report.counts[n]++;                                                                     \
+            }                                                                                           \
+        }                                                                                               \
     }
 
-void
-validate_table(stellar_collapse_eos *table)
+validation_report
+count_table_problems(const stellar_collapse_eos *table, const bool warn_each_point)
 {
-    const u32 nr   = table->n_rho;
-    const u32 nt   = table->n_temperature;
-    const u32 ny   = table->n_ye;
-    const u32 size = nr * nt * ny;
+    validation_report report;
+    memset(&report, 0, sizeof(report));
+    report.n_points      = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    report.axis_sizes[0] = table->n_rho;
+    report.axis_sizes[1] = table->n_temperature;
+    report.axis_sizes[2] = table->n_ye;
+
+    const f64 *axes[3] = {table->log10_rho, table->log10_temperature, table->ye};
+    for(int axis = 0; axis < 3; axis++) {
+        report.axis_problems[axis]
+            = count_decreasing_points(report.axis_sizes[axis], axes[axis], axis_names[axis], warn_each_point);
+    }
 
-    validate_increasing_monotonically(nr, table->log10_rho, "logrho");
-    validate_increasing_monotonically(nt, table->log10_temperature, "logtemp");
-    validate_increasing_monotonically(ny, table->ye, "ye");
+    COUNT_NON_FINITE(nan, nans);
+    COUNT_NON_FINITE(inf, infs);
 
-    CHECK_DATASETS_ARE_FINITE(nan);
-    CHECK_DATASETS_ARE_FINITE(inf);
+    return report;
+}
+
+u64
+print_validation_report(const validation_report *report)
+{
+    u64 problems = 0;
+    for(int axis = 0; axis < 3; axis++) {
+        if(report->axis_problems[axis]) {
+            warn(
+                "Found %" PRIu64 " problematic points in %" PRIu64 " for %s\n",
+                report->axis_problems[axis],
+                report->axis_sizes[axis],
+                axis_names[axis]
+            );
+        }
+        problems += report->axis_problems[axis];
+    }
+
+    const u64  *counts[2] = {report->nans, report->infs};
+    const char *kinds[2]  = {"nan", "inf"};
+    for(int k = 0; k < 2; k++) {
+        for(int n = 0; n < number_of_eos_quantities; n++) {
+            const char *name = stellar_collapse_qty_to_str(n);
+            if(counts[k][n]) {
+                warn(
+                    "Dataset '%s' has %" PRIu64 " %ss out of %" PRIu64 " points\n",
+                    name,
+                    counts[k][n],
+                    kinds[k],
+                    report->n_points
+                );
+            }
+            else {
+                info("Dataset '%s' does not contain %ss!\n", name, kinds[k]);
+            }
+            problems += counts[k][n];
+        }
+    }
+    return problems;
+}
+
+u64
+validate_table(stellar_collapse_eos *table)
+{
+    const validation_report report = count_table_problems(table, true);
+    return print_validation_report(&report);
 }
 
 // void
@@ -224,3 +176,39 @@ stellar_collapse_qty_to_str(stellar_collapse_eos_quantity qty)
             return "invalid table quantity";
     }
 }
+
+stellar_collapse_eos_quantity
+stellar_collapse_qty_from_str(const char *str)
+{
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!strcmp(str, stellar_collapse_qty_to_str(n))) {
+            return n;
+        }
+    }
+    return number_of_eos_quantities;
+}
+
+void
+mark_ye_planes_modified(stellar_collapse_eos *table, stellar_collapse_eos_quantity qty, i32 begin, i32 end)
+{
+    if(begin >= end) {
+        return;
+    }
+    if(!is_quantity_modified(table, qty)) {
+        table->modified_ye_begin[qty] = begin;
+        table->modified_ye_end[qty]   = end;
+        return;
+    }
+    if(begin < table->modified_ye_begin[qty]) {
+        table->modified_ye_begin[qty] = begin;
+    }
+    if(end > table->modified_ye_end[qty]) {
+        table->modified_ye_end[qty] = end;
+    }
+}
+
+bool
+is_quantity_modified(const stellar_collapse_eos *table, stellar_collapse_eos_quantity qty)
+{
+    return table->modified_ye_end[qty] > table->modified_ye_begin[qty];
+}
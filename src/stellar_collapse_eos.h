@@ -7,6 +7,8 @@
 #ifndef STELLAR_COLLAPSE_EOS_H
 #define STELLAR_COLLAPSE_EOS_H
 
+#include <stdbool.h>
+
 #include "basic_types.h"
 
 #define SPEED_OF_LIGHT_SI          (299792458.0)
@@ -51,8 +53,18 @@ typedef struct
     f64 *log10_rho, *log10_temperature, *ye; ///< Arrays storing the grid points for log10(rho), log10(T), and Ye.
     f64  energy_shift;                       ///< Energy shift applied to the specific internal energy.
     f64 *data[number_of_eos_quantities];     ///< Array of pointers to the data for each EOS quantity.
+    i32  modified_ye_begin[number_of_eos_quantities]; ///< First Ye plane of each quantity modified since reading.
+    i32  modified_ye_end[number_of_eos_quantities];   ///< One past the last modified Ye plane (none if <= begin).
 } stellar_collapse_eos;
 
+/**
+ * @brief Index bounds [lo, hi) of a box of table points, ordered as (rho, temperature, ye).
+ */
+typedef struct
+{
+    u64 lo[3], hi[3];
+} index_box_t;
+
 /**
  * @brief Reads a stellar collapse EOS table from a file.
  *
@@ -74,6 +86,34 @@ stellar_collapse_eos *read_stellar_collapse_eos_table(const char *filepath);
  */
 void write_stellar_collapse_eos_table(const stellar_collapse_eos *table, const char *filepath);
 
+/**
+ * @brief Writes a stellar collapse EOS table by copying everything that was not modified from the input file.
+ *
+ * All objects of the input file's root group (including extra datasets and groups) are carried over with H5Ocopy
+ * without being decoded, along with the root group attributes. Only the quantities modified since the table was read
+ * are written from memory. Inputs with an interleaved layout are refused before the output file is created.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure to write.
+ * @param input_filepath Path to the EOS table file the table was read from.
+ * @param output_filepath Path to the output EOS table file.
+ */
+void write_stellar_collapse_eos_table_copy_through(
+    const stellar_collapse_eos *table,
+    const char                 *input_filepath,
+    const char                 *output_filepath
+);
+
+/**
+ * @brief Updates a stellar collapse EOS table file in place.
+ *
+ * Only the Ye planes of each quantity that were modified since the table was read are written. Files with an
+ * interleaved layout are refused before anything is written.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure read from the file.
+ * @param filepath Path to the EOS table file to update.
+ */
+void update_stellar_collapse_eos_table_in_place(const stellar_collapse_eos *table, const char *filepath);
+
 /**
  * @brief Frees the memory allocated for a stellar collapse EOS table.
  *
@@ -103,6 +143,41 @@ void ensure_tables_are_equal_or_error(const char *filepath1, const char *filepat
  */
 void recompute_cs2_and_check_physical_limits(stellar_collapse_eos *table);
 
+/**
+ * @brief Recomputes cs2 (see recompute_cs2_and_check_physical_limits) only at the points inside a box.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure where cs2 will be recomputed.
+ * @param box Pointer to the box of points to recompute.
+ */
+void recompute_cs2_and_check_physical_limits_in_box(stellar_collapse_eos *table, const index_box_t *box);
+
+/**
+ * @brief Number of points where the recomputed cs2 is outside its physical limits.
+ */
+typedef struct
+{
+    u64 n_points;       ///< Number of points recomputed.
+    u64 n_negative;     ///< Number of points with a negative cs2.
+    u64 n_superluminal; ///< Number of points with a cs2 above the speed of light squared.
+} cs2_limits_report;
+
+/**
+ * @brief Recomputes cs2 inside a box like recompute_cs2_and_check_physical_limits_in_box, without printing anything.
+ *
+ * Used when the counts must be combined first, e.g., across the ranks of the MPI build.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure where cs2 will be recomputed.
+ * @param box Pointer to the box of points to recompute.
+ *
+ * @return The number of points outside the physical limits.
+ */
+cs2_limits_report recompute_cs2_in_box(stellar_collapse_eos *table, const index_box_t *box);
+
+/**
+ * @brief Prints the number of points outside the physical limits of cs2.
+ */
+void print_cs2_limits_report(const cs2_limits_report *report);
+
 /**
  * @brief Verifies the EOS table data for physical validity and finiteness.
  *
@@ -111,11 +186,64 @@ void recompute_cs2_and_check_physical_limits(stellar_collapse_eos *table);
  * If any inconsistencies or invalid values are found, the function will print warning messages.
  *
  * @param table Pointer to the stellar_collapse_eos structure that will be validated.
+ *
+ * @return The number of problems found (non-monotonic axis points, NaNs, and infinities).
+ */
+u64 validate_table(stellar_collapse_eos *table);
+
+/**
+ * @brief Number of problems of each kind found by validate_table.
+ */
+typedef struct
+{
+    u64 n_points;                       ///< Number of points of each tabulated quantity.
+    u64 axis_sizes[3];                  ///< Number of points of the logrho, logtemp, and ye axes.
+    u64 axis_problems[3];               ///< Number of points where each axis decreases.
+    u64 nans[number_of_eos_quantities]; ///< Number of NaNs in each quantity.
+    u64 infs[number_of_eos_quantities]; ///< Number of infinities in each quantity.
+} validation_report;
+
+/**
+ * @brief Counts the problems of a table (see validate_table) without printing the summary.
+ *
+ * Used when the counts must be combined first, e.g., across the ranks of the MPI build.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure that will be validated.
+ * @param warn_each_point Whether to also warn (rate-limited) about each problematic point.
+ */
+validation_report count_table_problems(const stellar_collapse_eos *table, bool warn_each_point);
+
+/**
+ * @brief Prints the problems counted by count_table_problems.
+ *
+ * @return The total number of problems.
  */
-void validate_table(stellar_collapse_eos *table);
+u64 print_validation_report(const validation_report *report);
 
 void recompute_derivs(stellar_collapse_eos *table);
 
 char *stellar_collapse_qty_to_str(stellar_collapse_eos_quantity qty);
 
+/**
+ * @brief Returns the quantity with the given dataset name, or number_of_eos_quantities if there is none.
+ *
+ * @param str The dataset name (e.g., "logpress").
+ */
+stellar_collapse_eos_quantity stellar_collapse_qty_from_str(const char *str);
+
+/**
+ * @brief Records that the Ye planes [begin, end) of a quantity were modified.
+ *
+ * @param table Pointer to the stellar_collapse_eos structure.
+ * @param qty The quantity that was modified.
+ * @param begin First modified Ye plane.
+ * @param end One past the last modified Ye plane.
+ */
+void mark_ye_planes_modified(stellar_collapse_eos *table, stellar_collapse_eos_quantity qty, i32 begin, i32 end);
+
+/**
+ * @brief Returns true if any point of the quantity was modified since the table was read.
+ */
+bool is_quantity_modified(const stellar_collapse_eos *table, stellar_collapse_eos_quantity qty);
+
 #endif // STELLAR_COLLAPSE_EOS_H
@@ -0,0 +1,567 @@
+#include <hdf5.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_table.h"
+#include "hdf5_helpers.h"
+#include "interleaved_layout.h"
+#include "precision.h"
+#include "stellar_collapse_eos.h"
+#include "utils.h"
+
+#define INTERLEAVED_DATASET "interleaved"
+
+static void
+dequantize_quantity(hid_t file_id, const stellar_collapse_eos *table, const char *name, f64 *data)
+{
+    // Quantized datasets store integer levels, which are converted to f64 exactly when read
+    hid_t        dataset_id = H5Dopen(file_id, name, H5P_DEFAULT);
+    quantization q;
+    if(read_hdf5_attribute(dataset_id, I32, "quantization_bits", &q.bits)) {
+        read_hdf5_attribute(dataset_id, F64, "quantization_offset", &q.offset);
+        read_hdf5_attribute(dataset_id, F64, "quantization_scale", &q.scale);
+        dequantize(&q, (u64)table->n_rho * table->n_temperature * table->n_ye, data);
+        debug("Dequantized dataset '%s' (%d bits)\n", name, q.bits);
+    }
+    H5Dclose(dataset_id);
+}
+
+static void
+read_interleaved_quantities(hid_t file_id, stellar_collapse_eos *table)
+{
+    hid_t dataset_id = H5Dopen(file_id, INTERLEAVED_DATASET, H5P_DEFAULT);
+
+    char quantities[1024];
+    i32  stride, tile;
+    if(!read_hdf5_string_attribute(dataset_id, "quantities", quantities, sizeof(quantities))
+       || !read_hdf5_attribute(dataset_id, I32, "record_size", &stride)
+       || !read_hdf5_attribute(dataset_id, I32, "tile_size", &tile)) {
+        error(HDF5_DATASET_READ_FAILED, "Dataset '%s' is missing its layout attributes\n", INTERLEAVED_DATASET);
+    }
+    H5Dclose(dataset_id);
+
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+    const int                     n_qtys = parse_quantity_list(quantities, qtys);
+    interleaved_layout            layout = make_interleaved_layout(table, qtys, n_qtys, false, tile);
+    if(stride < n_qtys) {
+        error(HDF5_DATASET_READ_FAILED, "Record size %d is smaller than the number of quantities %d\n", stride, n_qtys);
+    }
+    layout.stride = stride;
+
+    if(get_hdf5_dataset_size(file_id, INTERLEAVED_DATASET) != interleaved_layout_size(&layout)) {
+        error(HDF5_DATASET_READ_FAILED, "Dataset '%s' does not match its layout attributes\n", INTERLEAVED_DATASET);
+    }
+
+    f64 *records = read_hdf5_dataset(file_id, F64, INTERLEAVED_DATASET);
+    deinterleave_table(table, &layout, records);
+    free(records);
+
+    debug("Read %d interleaved quantities (record size %d, tile size %d)\n", n_qtys, stride, tile);
+}
+
+stellar_collapse_eos *
+read_stellar_collapse_eos_table(const char *filepath)
+{
+    // Binary tables skip HDF5 altogether
+    if(is_binary_table_file(filepath)) {
+        return read_binary_table(filepath);
+    }
+
+    hid_t file_id = open_hdf5_file(filepath, H5F_ACC_RDONLY);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    stellar_collapse_eos *table = malloc_or_error(sizeof(stellar_collapse_eos));
+    memset(table, 0, sizeof(stellar_collapse_eos));
+
+    // Scalar quantities and basic tabulated quantities
+    hdf5_dataset_transfer grid[7] = {
+        {"pointsrho",    I32, 0, NULL, NULL},
+        {"pointstemp",   I32, 0, NULL, NULL},
+        {"pointsye",     I32, 0, NULL, NULL},
+        {"energy_shift", F64, 0, NULL, NULL},
+        {"ye",           F64, 0, NULL, NULL},
+        {"logtemp",      F64, 0, NULL, NULL},
+        {"logrho",       F64, 0, NULL, NULL},
+    };
+    read_hdf5_datasets(file_id, 7, grid);
+    table->n_rho             = *(i32 *)grid[0].data;
+    table->n_temperature     = *(i32 *)grid[1].data;
+    table->n_ye              = *(i32 *)grid[2].data;
+    table->energy_shift      = *(f64 *)grid[3].data;
+    table->ye                = grid[4].data;
+    table->log10_temperature = grid[5].data;
+    table->log10_rho         = grid[6].data;
+    for(int i = 0; i < 4; i++) {
+        free(grid[i].data);
+    }
+
+    // Tabulated data, possibly written with an interleaved layout
+    if(H5Lexists(file_id, INTERLEAVED_DATASET, H5P_DEFAULT) > 0) {
+        read_interleaved_quantities(file_id, table);
+    }
+
+    // The remaining quantities are read in a single transfer
+    hdf5_dataset_transfer         transfers[number_of_eos_quantities];
+    stellar_collapse_eos_quantity qtys[number_of_eos_quantities];
+    int                           n_transfers = 0;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!table->data[n]) {
+            const hdf5_dataset_transfer transfer = {stellar_collapse_qty_to_str(n), F64, 0, NULL, NULL};
+            qtys[n_transfers]                    = n;
+            transfers[n_transfers++]             = transfer;
+        }
+    }
+    read_hdf5_datasets(file_id, n_transfers, transfers);
+    for(int i = 0; i < n_transfers; i++) {
+        table->data[qtys[i]] = transfers[i].data;
+        dequantize_quantity(file_id, table, transfers[i].name, transfers[i].data);
+    }
+
+    H5Fclose(file_id);
+
+    return table;
+}
+
+#define GRID_DATASETS  (7)                                                ///< Scalars and axes of the grid.
+#define TABLE_DATASETS (GRID_DATASETS + number_of_eos_quantities + 1) ///< Upper bound on the datasets of a table.
+
+// The datasets are written together with the tabulated data; dims must hold {1, n_ye, n_temperature, n_rho}
+static int
+add_grid_transfers(const stellar_collapse_eos *table, const hsize_t *dims, hdf5_dataset_transfer *transfers)
+{
+    const hdf5_dataset_transfer grid[GRID_DATASETS] = {
+        // Scalar quantities
+        {"pointsrho",    I32, 1, dims,     (void *)&table->n_rho         },
+        {"pointstemp",   I32, 1, dims,     (void *)&table->n_temperature },
+        {"pointsye",     I32, 1, dims,     (void *)&table->n_ye          },
+        {"energy_shift", F64, 1, dims,     (void *)&table->energy_shift  },
+        // Basic tabulated quantities
+        {"ye",           F64, 1, dims + 1, table->ye                     },
+        {"logtemp",      F64, 1, dims + 2, table->log10_temperature      },
+        {"logrho",       F64, 1, dims + 3, table->log10_rho              },
+    };
+    memcpy(transfers, grid, sizeof(grid));
+    return GRID_DATASETS;
+}
+
+void
+write_stellar_collapse_eos_table(const stellar_collapse_eos *table, const char *filepath)
+{
+    hid_t file_id = create_hdf5_file(filepath);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    // Grid and tabulated data, in a single transfer
+    const hsize_t         dims[4] = {1, table->n_ye, table->n_temperature, table->n_rho};
+    hdf5_dataset_transfer transfers[TABLE_DATASETS];
+    int                   n_transfers = add_grid_transfers(table, dims, transfers);
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        const hdf5_dataset_transfer transfer = {stellar_collapse_qty_to_str(n), F64, 3, dims + 1, table->data[n]};
+        transfers[n_transfers++]             = transfer;
+    }
+    write_hdf5_datasets(file_id, n_transfers, transfers);
+
+    H5Fclose(file_id);
+}
+
+void
+write_stellar_collapse_eos_table_interleaved(
+    const stellar_collapse_eos *table,
+    const interleaved_layout   *layout,
+    const char                 *filepath
+)
+{
+    hid_t file_id = create_hdf5_file(filepath);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    write_hdf5_string_attribute(file_id, "layout", INTERLEAVED_DATASET);
+
+    // Quantities that are not interleaved are kept as planar datasets
+    bool interleaved[number_of_eos_quantities] = {false};
+    char quantities[1024]                      = "";
+    for(i32 q = 0; q < layout->n_qtys; q++) {
+        interleaved[layout->qtys[q]] = true;
+        strcat(quantities, q > 0 ? "," : "");
+        strcat(quantities, stellar_collapse_qty_to_str(layout->qtys[q]));
+    }
+
+    const hsize_t         dims[4] = {1, table->n_ye, table->n_temperature, table->n_rho};
+    hdf5_dataset_transfer transfers[TABLE_DATASETS];
+    int                   n_transfers = add_grid_transfers(table, dims, transfers);
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!interleaved[n]) {
+            const hdf5_dataset_transfer transfer = {stellar_collapse_qty_to_str(n), F64, 3, dims + 1, table->data[n]};
+            transfers[n_transfers++]             = transfer;
+        }
+    }
+
+    const hsize_t               size     = interleaved_layout_size(layout);
+    f64                        *records  = malloc_or_error(sizeof(f64) * size);
+    const hdf5_dataset_transfer transfer = {INTERLEAVED_DATASET, F64, 1, &size, records};
+    transfers[n_transfers++]             = transfer;
+    interleave_table(table, layout, records);
+    write_hdf5_datasets(file_id, n_transfers, transfers);
+    free(records);
+
+    hid_t dataset_id = H5Dopen(file_id, INTERLEAVED_DATASET, H5P_DEFAULT);
+    write_hdf5_string_attribute(dataset_id, "quantities", quantities);
+    write_hdf5_attribute(dataset_id, I32, "record_size", &layout->stride);
+    write_hdf5_attribute(dataset_id, I32, "tile_size", &layout->tile);
+    H5Dclose(dataset_id);
+
+    H5Fclose(file_id);
+}
+
+// Opens a file only to inspect it; files that are not HDF5 are left for the reader to report
+static hid_t
+open_hdf5_file_quietly(const char *filepath)
+{
+    hid_t file_id = -1;
+    H5E_BEGIN_TRY
+    {
+        file_id = open_hdf5_file(filepath, H5F_ACC_RDONLY);
+    }
+    H5E_END_TRY;
+    return file_id;
+}
+
+bool
+is_interleaved_table_file(const char *filepath)
+{
+    hid_t file_id = open_hdf5_file_quietly(filepath);
+    if(file_id < 0) {
+        return false;
+    }
+    const bool found = H5Lexists(file_id, INTERLEAVED_DATASET, H5P_DEFAULT) > 0;
+    H5Fclose(file_id);
+    return found;
+}
+
+// Quantized datasets hold integer levels and f32 ones round what is written to them, so neither can take f64 updates
+static bool
+has_reduced_precision_quantities(hid_t file_id)
+{
+    bool found = false;
+    for(int n = 0; !found && n < number_of_eos_quantities; n++) {
+        const char *name = stellar_collapse_qty_to_str(n);
+        if(H5Lexists(file_id, name, H5P_DEFAULT) <= 0) {
+            continue;
+        }
+        hid_t      dataset_id = H5Dopen(file_id, name, H5P_DEFAULT);
+        hid_t      type_id    = H5Dget_type(dataset_id);
+        const bool quantized  = H5Aexists(dataset_id, "quantization_bits") > 0;
+        found = quantized || H5Tget_class(type_id) != H5T_FLOAT || H5Tget_size(type_id) != sizeof(f64);
+        H5Tclose(type_id);
+        H5Dclose(dataset_id);
+    }
+    return found;
+}
+
+bool
+is_reduced_precision_table_file(const char *filepath)
+{
+    hid_t file_id = open_hdf5_file_quietly(filepath);
+    if(file_id < 0) {
+        return false;
+    }
+    const bool found = has_reduced_precision_quantities(file_id);
+    H5Fclose(file_id);
+    return found;
+}
+
+static void *
+narrow_quantized_levels(u32 *levels, const u64 size, const dataset_type dtype)
+{
+    if(dtype == U32) {
+        return levels;
+    }
+
+    void *narrow = malloc_or_error(H5Tget_size(hdf5_native_type(dtype)) * size);
+    for(u64 i = 0; i < size; i++) {
+        if(dtype == U8) {
+            ((u8 *)narrow)[i] = (u8)levels[i];
+        }
+        else {
+            ((u16 *)narrow)[i] = (u16)levels[i];
+        }
+    }
+    free(levels);
+    return narrow;
+}
+
+void
+write_stellar_collapse_eos_table_reduced(
+    const stellar_collapse_eos *table,
+    const precision_spec       *specs,
+    const char                 *filepath
+)
+{
+    const u64     size    = (u64)table->n_rho * table->n_temperature * table->n_ye;
+    const hsize_t dims[3] = {table->n_ye, table->n_temperature, table->n_rho};
+
+    // Reduce and check every quantity before creating the file
+    void        *reduced[number_of_eos_quantities] = {NULL};
+    quantization q[number_of_eos_quantities]       = {{0}};
+    dataset_type dtypes[number_of_eos_quantities];
+    u64          bytes = 0, violations = 0;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        const char *name = stellar_collapse_qty_to_str(n);
+        char        spec_str[64];
+        f64         max_error = 0;
+        u64         bad       = 0;
+
+        switch(specs[n].type) {
+            case PRECISION_F32:
+                reduced[n] = malloc_or_error(sizeof(f32) * size);
+                bad        = convert_to_f32(table->data[n], size, &specs[n], reduced[n], &max_error);
+                dtypes[n]  = F32;
+                bytes     += sizeof(f32) * size;
+                break;
+            case PRECISION_QUANTIZED: {
+                u32 *levels = malloc_or_error(sizeof(u32) * size);
+                bad         = quantize(table->data[n], size, &specs[n], &q[n], levels, &max_error);
+
+                // Store the levels in the smallest unsigned type that holds them
+                dtypes[n]  = q[n].bits <= 8 ? U8 : (q[n].bits <= 16 ? U16 : U32);
+                reduced[n] = narrow_quantized_levels(levels, size, dtypes[n]);
+                bytes     += H5Tget_size(hdf5_native_type(dtypes[n])) * size;
+                break;
+            }
+            default:
+                bytes += sizeof(f64) * size;
+                continue;
+        }
+
+        precision_spec_to_str(&specs[n], spec_str, sizeof(spec_str));
+        if(specs[n].type == PRECISION_QUANTIZED) {
+            info("  %-9s: %s, %d bits, max error %.3e\n", name, spec_str, q[n].bits, max_error);
+        }
+        else {
+            info("  %-9s: %s, max error %.3e\n", name, spec_str, max_error);
+        }
+        if(bad) {
+            warn("  %-9s: %" PRIu64 " points exceed the error bound\n", name, bad);
+        }
+        violations += bad;
+    }
+
+    if(violations) {
+        for(int n = 0; n < number_of_eos_quantities; n++) {
+            free(reduced[n]);
+        }
+        error(INVALID_ARGUMENT, "Error bounds not met at %" PRIu64 " points; table not written\n", violations);
+    }
+
+    hid_t file_id = create_hdf5_file(filepath);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", filepath);
+    }
+
+    const hsize_t         grid_dims[4] = {1, table->n_ye, table->n_temperature, table->n_rho};
+    hdf5_dataset_transfer transfers[TABLE_DATASETS];
+    int                   n_transfers = add_grid_transfers(table, grid_dims, transfers);
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        const hdf5_dataset_transfer transfer = {
+            stellar_collapse_qty_to_str(n),
+            reduced[n] ? dtypes[n] : F64,
+            3,
+            dims,
+            reduced[n] ? reduced[n] : table->data[n],
+        };
+        transfers[n_transfers++] = transfer;
+    }
+    write_hdf5_datasets(file_id, n_transfers, transfers);
+
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        const char *name = stellar_collapse_qty_to_str(n);
+        if(specs[n].type == PRECISION_QUANTIZED) {
+            hid_t dataset_id = H5Dopen(file_id, name, H5P_DEFAULT);
+            write_hdf5_attribute(dataset_id, I32, "quantization_bits", &q[n].bits);
+            write_hdf5_attribute(dataset_id, F64, "quantization_offset", &q[n].offset);
+            write_hdf5_attribute(dataset_id, F64, "quantization_scale", &q[n].scale);
+            H5Dclose(dataset_id);
+        }
+        free(reduced[n]);
+    }
+
+    H5Fclose(file_id);
+
+    const f64 full_bytes = (f64)sizeof(f64) * size * number_of_eos_quantities;
+    info(
+        "Reduced precision: %.1f MB -> %.1f MB (compression %.2fx)\n",
+        full_bytes / 1e6,
+        bytes / 1e6,
+        full_bytes / bytes
+    );
+}
+
+// Copy-through and in-place updates write the modified quantities as planar f64 datasets, so the input must hold all
+// of them that way. Checked before anything is written, so that a refused file is left untouched.
+static void
+ensure_planar_quantities_or_error(hid_t file_id, const stellar_collapse_eos *table, const char *filepath)
+{
+    if(H5Lexists(file_id, INTERLEAVED_DATASET, H5P_DEFAULT) > 0) {
+        H5Fclose(file_id);
+        error(
+            UNSUPPORTED_FEATURE,
+            "Table '%s' has an interleaved layout and cannot be copied through or updated in place\n",
+            filepath
+        );
+    }
+    if(has_reduced_precision_quantities(file_id)) {
+        H5Fclose(file_id);
+        error(
+            UNSUPPORTED_FEATURE,
+            "Table '%s' has reduced precision quantities and cannot be copied through or updated in place\n",
+            filepath
+        );
+    }
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(is_quantity_modified(table, n) && H5Lexists(file_id, stellar_collapse_qty_to_str(n), H5P_DEFAULT) <= 0) {
+            H5Fclose(file_id);
+            error(HDF5_DATASET_NOT_FOUND, "Dataset '%s' not found in '%s'\n", stellar_collapse_qty_to_str(n), filepath);
+        }
+    }
+}
+
+typedef struct
+{
+    const stellar_collapse_eos *table;
+    hid_t                       output_file_id;
+} copy_through_context;
+
+static herr_t
+copy_unmodified_object(hid_t input_file_id, const char *name, const H5L_info_t *link_info, void *data)
+{
+    (void)link_info;
+    const copy_through_context         *ctx = (const copy_through_context *)data;
+    const stellar_collapse_eos_quantity qty = stellar_collapse_qty_from_str(name);
+
+    if(qty != number_of_eos_quantities && is_quantity_modified(ctx->table, qty)) {
+        return 0;
+    }
+    if(H5Ocopy(input_file_id, name, ctx->output_file_id, name, H5P_DEFAULT, H5P_DEFAULT) < 0) {
+        error(HDF5_DATASET_WRITE_FAILED, "Could not copy object '%s'.\n", name);
+    }
+    debug("Copied object '%s'\n", name);
+    return 0;
+}
+
+void
+write_stellar_collapse_eos_table_copy_through(
+    const stellar_collapse_eos *table,
+    const char                 *input_filepath,
+    const char                 *output_filepath
+)
+{
+    hid_t input_file_id = open_hdf5_file(input_filepath, H5F_ACC_RDONLY);
+    if(input_file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", input_filepath);
+    }
+    ensure_planar_quantities_or_error(input_file_id, table, input_filepath);
+
+    hid_t output_file_id = create_hdf5_file(output_filepath);
+    if(output_file_id < 0) {
+        H5Fclose(input_file_id);
+        error(FILE_OPEN_FAILED, "Could not open file '%s'\n", output_filepath);
+    }
+
+    copy_hdf5_attributes(input_file_id, output_file_id);
+
+    copy_through_context ctx = {table, output_file_id};
+    H5Literate(input_file_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, copy_unmodified_object, &ctx);
+    H5Fclose(input_file_id);
+
+    const hsize_t         dims[3] = {table->n_ye, table->n_temperature, table->n_rho};
+    hdf5_dataset_transfer transfers[number_of_eos_quantities];
+    int                   n_transfers = 0;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(is_quantity_modified(table, n)) {
+            const hdf5_dataset_transfer transfer = {stellar_collapse_qty_to_str(n), F64, 3, dims, table->data[n]};
+            transfers[n_transfers++]             = transfer;
+        }
+    }
+    write_hdf5_datasets(output_file_id, n_transfers, transfers);
+
+    H5Fclose(output_file_id);
+}
+
+void
+update_stellar_collapse_eos_table_in_place(const stellar_collapse_eos *table, const char *filepath)
+{
+    hid_t file_id = open_hdf5_file(filepath, H5F_ACC_RDWR);
+    if(file_id < 0) {
+        error(FILE_OPEN_FAILED, "Could not open file '%s' for writing\n", filepath);
+    }
+    ensure_planar_quantities_or_error(file_id, table, filepath);
+
+    const usize plane_size = (usize)table->n_rho * table->n_temperature;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(!is_quantity_modified(table, n)) {
+            continue;
+        }
+        const i32     begin     = table->modified_ye_begin[n];
+        const i32     end       = table->modified_ye_end[n];
+        const hsize_t offset[3] = {begin, 0, 0};
+        const hsize_t count[3]  = {end - begin, table->n_temperature, table->n_rho};
+        update_hdf5_dataset_hyperslab(
+            file_id,
+            F64,
+            stellar_collapse_qty_to_str(n),
+            offset,
+            count,
+            table->data[n] + begin * plane_size
+        );
+        debug("Updated Ye planes [%d, %d) of dataset '%s'\n", begin, end, stellar_collapse_qty_to_str(n));
+    }
+
+    H5Fclose(file_id);
+}
+
+#define CHECK_SCALAR(name)                                                            \
+    if(table1->name != table2->name) {                                                \
+        warn("Error in %s: %g != %g\n", #name, (f64)table1->name, (f64)table2->name); \
+    }
+
+void
+ensure_tables_are_equal_or_error(const char *filepath1, const char *filepath2)
+{
+    stellar_collapse_eos *table1 = read_stellar_collapse_eos_table(filepath1);
+    stellar_collapse_eos *table2 = read_stellar_collapse_eos_table(filepath2);
+
+    CHECK_SCALAR(n_rho);
+    CHECK_SCALAR(n_temperature);
+    CHECK_SCALAR(n_ye);
+    CHECK_SCALAR(energy_shift);
+
+    const u64 size             = (u64)table1->n_rho * table1->n_temperature * table1->n_ye;
+    bool      all_tests_passed = true;
+    for(u32 n = 0; n < number_of_eos_quantities; n++) {
+        debug("Validating dataset '%-9s'\n", stellar_collapse_qty_to_str(n));
+        for(u64 i = 0; i < size; i++) {
+            if(table1->data[n][i] != table2->data[n][i]) {
+                WARN_RATE_LIMITED(
+                    "Error in %s: %g != %g\n",
+                    stellar_collapse_qty_to_str(n),
+                    table1->data[n][i],
+                    table2->data[n][i]
+                );
+                all_tests_passed = false;
+            }
+        }
+    }
+
+    free_stellar_collapse_eos_table(table1);
+    free_stellar_collapse_eos_table(table2);
+
+    if(all_tests_passed) {
+        info("All tests passed!\n");
+    }
+}
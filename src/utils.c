@@ -1,22 +1,275 @@
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include <string.h>
+
 #include "utils.h"
 
+static bool        info_messages_enabled = true;
+static log_level_t log_level             = LOG_DEBUG;
+static jmp_buf    *error_trap            = NULL;
+static error_t     last_error_key        = SUCCESS;
+static char        last_error[1024]      = "";
+
+// Each message is stored as a record: its sequence number, the stream (0 for stdout, 1 for stderr), and the text
+#define LOG_RECORD_HEADER (sizeof(unsigned long long) + 1)
+
+typedef struct
+{
+    size_t len;
+    char   data[LOG_BUFFER_SIZE];
+} log_buffer;
+
+static log_buffer        *log_buffers[LOG_MAX_THREADS];
+static int                n_log_buffers    = 0;
+static unsigned long long log_sequence     = 0;
+static log_site          *active_sites     = NULL;
+static log_buffer        *thread_buffer    = NULL;
+#ifdef _OPENMP
+#    pragma omp threadprivate(thread_buffer)
+#endif
+
+static log_buffer *
+get_thread_buffer(void)
+{
+    if(thread_buffer) {
+        return thread_buffer;
+    }
+
+    log_buffer *buffer = NULL;
+#ifdef _OPENMP
+#    pragma omp critical(log_registry)
+#endif
+    {
+        // Not malloc_or_error, which logs; without a buffer, messages are written directly
+        if(n_log_buffers < LOG_MAX_THREADS && (buffer = malloc(sizeof(log_buffer)))) {
+            buffer->len                  = 0;
+            log_buffers[n_log_buffers++] = buffer;
+            if(n_log_buffers == 1) {
+                atexit(flush_log);
+            }
+        }
+    }
+    thread_buffer = buffer;
+    return buffer;
+}
+
+static unsigned long long
+record_sequence(const char *record)
+{
+    unsigned long long sequence;
+    memcpy(&sequence, record, sizeof(sequence));
+    return sequence;
+}
+
+static size_t
+write_record(const char *record, FILE **last_fp)
+{
+    FILE       *fp   = record[sizeof(unsigned long long)] ? stderr : stdout;
+    const char *text = record + LOG_RECORD_HEADER;
+    if(*last_fp && *last_fp != fp) {
+        // Keeps the order of messages written to different streams
+        fflush(*last_fp);
+    }
+    fputs(text, fp);
+    *last_fp = fp;
+    return LOG_RECORD_HEADER + strlen(text) + 1;
+}
+
+static void
+write_buffer(log_buffer *buffer)
+{
+    FILE *last_fp = NULL;
+#ifdef _OPENMP
+#    pragma omp critical(log_output)
+#endif
+    {
+        for(size_t pos = 0; pos < buffer->len;) {
+            pos += write_record(buffer->data + pos, &last_fp);
+        }
+        buffer->len = 0;
+        fflush(stdout);
+        fflush(stderr);
+    }
+}
+
+static void
+write_all_buffers(void)
+{
+    // Merges the records of all threads in the order they were logged
+    size_t pos[LOG_MAX_THREADS] = {0};
+    FILE  *last_fp              = NULL;
+    for(;;) {
+        int                next          = -1;
+        unsigned long long next_sequence = 0;
+        for(int n = 0; n < n_log_buffers; n++) {
+            if(pos[n] < log_buffers[n]->len) {
+                const unsigned long long sequence = record_sequence(log_buffers[n]->data + pos[n]);
+                if(next < 0 || sequence < next_sequence) {
+                    next          = n;
+                    next_sequence = sequence;
+                }
+            }
+        }
+        if(next < 0) {
+            break;
+        }
+        pos[next] += write_record(log_buffers[next]->data + pos[next], &last_fp);
+    }
+    for(int n = 0; n < n_log_buffers; n++) {
+        log_buffers[n]->len = 0;
+    }
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static bool
+buffer_message(log_buffer *buffer, FILE *fp, const char *prefix, const char *format, va_list args)
+{
+    const size_t prefix_len = strlen(prefix);
+    const size_t room       = LOG_BUFFER_SIZE - buffer->len;
+    if(room < LOG_RECORD_HEADER + prefix_len + 1) {
+        return false;
+    }
+
+    char        *record = buffer->data + buffer->len;
+    char        *text   = record + LOG_RECORD_HEADER + prefix_len;
+    const size_t size   = room - LOG_RECORD_HEADER - prefix_len;
+    va_list      copy;
+    va_copy(copy, args);
+    const int len = vsnprintf(text, size, format, copy);
+    va_end(copy);
+    if(len < 0 || LOG_RECORD_HEADER + prefix_len + len + 1 > room) {
+        return false;
+    }
+
+    unsigned long long sequence;
+#ifdef _OPENMP
+#    pragma omp atomic capture
+#endif
+    sequence = log_sequence++;
+    memcpy(record, &sequence, sizeof(sequence));
+    record[sizeof(sequence)] = fp == stderr;
+    memcpy(record + LOG_RECORD_HEADER, prefix, prefix_len);
+    buffer->len += LOG_RECORD_HEADER + prefix_len + len + 1;
+    return true;
+}
+
+static void
+log_message(FILE *fp, const char *prefix, const char *format, va_list args)
+{
+    log_buffer *buffer = get_thread_buffer();
+    if(buffer) {
+        if(buffer_message(buffer, fp, prefix, format, args)) {
+            return;
+        }
+        // Make room and try again
+        write_buffer(buffer);
+        if(buffer_message(buffer, fp, prefix, format, args)) {
+            return;
+        }
+    }
+
+    // Too long for the buffer
+#ifdef _OPENMP
+#    pragma omp critical(log_output)
+#endif
+    {
+        fputs(prefix, fp);
+        vfprintf(fp, format, args);
+        fflush(fp);
+    }
+}
+
 static void
 generic_message(FILE *fp, const error_t key, const char *prefix, const char *format, va_list args)
 {
+    if(key == SUCCESS) {
+        log_message(fp, prefix, format, args);
+        va_end(args);
+        return;
+    }
+
+    // Everything logged before the error is written first
+    flush_log();
     fputs(prefix, fp);
 
+    va_list copy;
+    va_copy(copy, args);
+    vsnprintf(last_error, sizeof(last_error), format, copy);
+    va_end(copy);
+
     vfprintf(fp, format, args);
     fflush(fp);
     va_end(args);
 
-    if(key != SUCCESS) {
-        exit(key);
+    last_error_key = key;
+    if(error_trap) {
+        longjmp(*error_trap, key);
     }
+    exit(key);
+}
+
+log_level_t
+set_log_level(const log_level_t level)
+{
+    const log_level_t previous = log_level;
+    log_level                  = level;
+    return previous;
+}
+
+static void
+report_suppressed_messages(void)
+{
+    for(log_site *site = active_sites; site; site = site->next) {
+        if(site->count > LOG_RATE_LIMIT) {
+            const unsigned long suppressed = site->count - LOG_RATE_LIMIT;
+            warn("%lu more similar warnings suppressed (%s:%d)\n", suppressed, site->file, site->line);
+        }
+    }
+
+    // Every call site starts the next stage with a clean count, not only the ones that hit the limit
+    for(log_site *site = active_sites; site;) {
+        log_site *next = site->next;
+        site->count    = 0;
+        site->next     = NULL;
+        site           = next;
+    }
+    active_sites = NULL;
+}
+
+void
+flush_log(void)
+{
+#ifdef _OPENMP
+    if(omp_in_parallel()) {
+        // Other threads may be logging: only the buffer of this one is written, and the call sites are left for the
+        // next flush outside of parallel regions to report and reset
+        if(thread_buffer) {
+            write_buffer(thread_buffer);
+        }
+        return;
+    }
+#endif
+    report_suppressed_messages();
+    write_all_buffers();
+}
+
+bool
+set_info_messages_enabled(const bool enabled)
+{
+    const bool previous   = info_messages_enabled;
+    info_messages_enabled = enabled;
+    return previous;
 }
 
 void
 info(const char *format, ...)
 {
+    if(!info_messages_enabled || log_level < LOG_INFO) {
+        return;
+    }
     va_list args;
     va_start(args, format);
     generic_message(stdout, SUCCESS, "(info) ", format, args);
@@ -26,6 +279,9 @@ void
 debug(const char *format, ...)
 {
 #ifndef NDEBUG
+    if(log_level < LOG_DEBUG) {
+        return;
+    }
     va_list args;
     va_start(args, format);
     generic_message(stderr, SUCCESS, "(debug) ", format, args);
@@ -37,6 +293,36 @@ debug(const char *format, ...)
 void
 warn(const char *format, ...)
 {
+    if(log_level < LOG_WARNING) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    generic_message(stderr, SUCCESS, "(warning) ", format, args);
+}
+
+void
+warn_rate_limited(log_site *site, const char *format, ...)
+{
+    unsigned long count;
+#ifdef _OPENMP
+#    pragma omp atomic capture
+#endif
+    count = ++site->count;
+
+    if(count == 1) {
+        // The first message since the last flush registers the call site, so that the flush resets its count
+#ifdef _OPENMP
+#    pragma omp critical(log_registry)
+#endif
+        {
+            site->next   = active_sites;
+            active_sites = site;
+        }
+    }
+    if(count > LOG_RATE_LIMIT || log_level < LOG_WARNING) {
+        return;
+    }
     va_list args;
     va_start(args, format);
     generic_message(stderr, SUCCESS, "(warning) ", format, args);
@@ -50,6 +336,24 @@ error(const error_t key, const char *format, ...)
     generic_message(stderr, key, "(error) ", format, args);
 }
 
+void
+set_error_trap(jmp_buf *trap)
+{
+    error_trap = trap;
+}
+
+error_t
+last_error_code(void)
+{
+    return last_error_key;
+}
+
+const char *
+last_error_message(void)
+{
+    return last_error;
+}
+
 void *
 malloc_or_error(const size_t size)
 {
@@ -8,12 +8,18 @@
  * levels (info, warning, debug, error), a custom error type enum, and a macro
  * for simplified error reporting with file, line, and function context. It also
  * includes a safe memory allocation function that handles potential errors.
+ *
+ * Messages are buffered per thread and written at stage boundaries (see flush_log), so logging from inside OpenMP
+ * parallel regions is safe and cheap, and lines from different threads are never interleaved.
  */
 
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <inttypes.h>
+#include <setjmp.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -35,8 +41,58 @@ typedef enum
     INVALID_SMOOTHER,             ///< Invalid smoothing option.
     INVALID_DERIVS,               ///< Invalid derivative smoothing option.
     UNSUPPORTED_FEATURE,          ///< Feature not yet supported.
+    INVALID_DECOMPOSITION,        ///< Table cannot be split across the requested number of ranks.
+    INVALID_ARGUMENT,             ///< Invalid argument passed to the library API.
+    INVALID_TABLE,                ///< Table failed validation (NaNs, infinities, or non-monotonic axes).
+    FILE_IO_FAILED,               ///< Failed to read from or write to a file.
+    INVALID_FILE_FORMAT,          ///< File is truncated, corrupt, or in an unsupported format or version.
 } error_t;
 
+/**
+ * @brief Verbosity levels of the log, from least to most verbose.
+ */
+typedef enum
+{
+    LOG_ERROR,   ///< Only errors.
+    LOG_WARNING, ///< Errors and warnings.
+    LOG_INFO,    ///< Errors, warnings, and informational messages.
+    LOG_DEBUG,   ///< All messages (default). Debug messages are only compiled in debug builds.
+} log_level_t;
+
+#define LOG_RATE_LIMIT  (10)      ///< Messages printed per rate-limited call site between flushes.
+#define LOG_BUFFER_SIZE (1 << 16) ///< Size of the per-thread message buffers.
+#define LOG_MAX_THREADS (1024)    ///< Maximum number of threads with their own buffer; others write directly.
+
+/**
+ * @brief State of a rate-limited call site (see WARN_RATE_LIMITED).
+ */
+typedef struct log_site
+{
+    unsigned long    count; ///< Messages from this call site since the last flush.
+    const char      *file;  ///< Source file of the call site.
+    int              line;  ///< Source line of the call site.
+    struct log_site *next;  ///< Next call site that logged since the last flush.
+} log_site;
+
+/**
+ * @brief Sets the verbosity of the log.
+ *
+ * @param level Messages less important than this level are discarded.
+ *
+ * @return The previous level.
+ */
+log_level_t set_log_level(const log_level_t level);
+
+/**
+ * @brief Writes all buffered messages and reports how many messages each rate-limited call site suppressed.
+ *
+ * Called at stage boundaries. Outside of parallel regions the buffers of all threads are written and the counts of all
+ * rate-limited call sites are reset; inside, only the buffer of the calling thread is written, and the suppressed
+ * messages are reported by the next flush outside of parallel regions. Buffers are also written when they fill up,
+ * before errors, and at exit.
+ */
+void flush_log(void);
+
 /**
  * @brief Logs an informational message to standard output.
  *
@@ -45,6 +101,15 @@ typedef enum
  */
 void info(const char *format, ...);
 
+/**
+ * @brief Enables or disables informational messages, e.g., on all but one MPI rank.
+ *
+ * @param enabled Whether informational messages should be printed.
+ *
+ * @return The previous setting.
+ */
+bool set_info_messages_enabled(const bool enabled);
+
 /**
  * @brief Logs a warning message to standard error.
  *
@@ -53,6 +118,29 @@ void info(const char *format, ...);
  */
 void warn(const char *format, ...);
 
+/**
+ * @brief Logs a warning, unless its call site already logged LOG_RATE_LIMIT messages since the last flush.
+ *
+ * Use through WARN_RATE_LIMITED, which keeps the state of each call site.
+ *
+ * @param site Pointer to the state of the call site.
+ * @param format The format string (printf-style).
+ * @param ... Optional arguments for the format string.
+ */
+void warn_rate_limited(log_site *site, const char *format, ...);
+
+/**
+ * @brief Logs a warning from a call site that may produce many of them, e.g., once per table point.
+ *
+ * At most LOG_RATE_LIMIT warnings are printed per call site between flushes; the number of suppressed warnings is
+ * reported by flush_log.
+ */
+#define WARN_RATE_LIMITED(...)                                     \
+    do {                                                           \
+        static log_site log_site_ = {0, __FILE__, __LINE__, NULL}; \
+        warn_rate_limited(&log_site_, __VA_ARGS__);                \
+    } while(0)
+
 /**
  * @brief Logs a debug message to standard error (conditionally compiled only when NDEBUG is *not* defined).
  *
@@ -70,10 +158,33 @@ void debug(const char *format, ...);
  * @param format The format string (printf-style).
  * @param ... Optional arguments for the format string.
  *
- * @note This function terminates the program execution with the provided error code.
+ * @note This function terminates the program execution with the provided error code, unless an error trap is set
+ *       (see set_error_trap).
  */
 void error(const error_t key, const char *format, ...);
 
+/**
+ * @brief Makes error() jump to a trap instead of terminating the program.
+ *
+ * Used by the library API, which reports errors through return codes. After the jump, the error code and message
+ * are available through last_error_code() and last_error_message(). error() must not be called from inside OpenMP
+ * parallel regions, since jumping out of them is undefined behavior: parallel code records the error in a flag and
+ * calls error() after the region, once its work buffers are freed.
+ *
+ * @param trap Pointer to a jmp_buf initialized with setjmp, or NULL to restore the default behavior.
+ */
+void set_error_trap(jmp_buf *trap);
+
+/**
+ * @brief Returns the code of the last error reported through error().
+ */
+error_t last_error_code(void);
+
+/**
+ * @brief Returns the message of the last error reported through error().
+ */
+const char *last_error_message(void);
+
 /**
  * @brief Allocates memory using malloc and handles potential allocation failures.
  *
@@ -99,24 +210,24 @@ void *malloc_or_error(const size_t size);
     fprintf(stderr, "(error) File: %s\n(error) Line: %d\n(error) Func: %s\n", __FILE__, __LINE__, __func__); \
     error(key, format, ##__VA_ARGS__)
 
-#define CHECK_FINITE(new, old, func)                         \
-    if(is##func(new)) {                                      \
-        if(is##func(old)) {                                  \
-            warn("%llu: BAD - both are %s\n", index, #func); \
-        }                                                    \
-        else {                                               \
-            warn("%llu: WORSE - new is %s\n", index, #func); \
-        }                                                    \
+#define CHECK_FINITE(new, old, func)                                                         \
+    if(is##func(new)) {                                                                      \
+        if(is##func(old)) {                                                                  \
+            WARN_RATE_LIMITED("%" PRIu64 ": BAD - both are %s\n", (uint64_t)(index), #func); \
+        }                                                                                    \
+        else {                                                                               \
+            WARN_RATE_LIMITED("%" PRIu64 ": WORSE - new is %s\n", (uint64_t)(index), #func); \
+        }                                                                                    \
     }
 
-#define CHECK_BOUNDS(new, old, op, bound)                              \
-    if((new)op(bound)) {                                               \
-        if((old)op(bound)) {                                           \
-            warn("%llu: BAD - both are %s %g\n", index, #op, (bound)); \
-        }                                                              \
-        else {                                                         \
-            warn("%llu: WORSE - new is %s %g\n", index, #op, (bound)); \
-        }                                                              \
+#define CHECK_BOUNDS(new, old, op, bound)                                                              \
+    if((new)op(bound)) {                                                                               \
+        if((old)op(bound)) {                                                                           \
+            WARN_RATE_LIMITED("%" PRIu64 ": BAD - both are %s %g\n", (uint64_t)(index), #op, (bound)); \
+        }                                                                                              \
+        else {                                                                                         \
+            WARN_RATE_LIMITED("%" PRIu64 ": WORSE - new is %s %g\n", (uint64_t)(index), #op, (bound)); \
+        }                                                                                              \
     }
 
 #endif // UTILS_H
@@ -0,0 +1,232 @@
+// Checks that the index, box, and tile arithmetic of tables with more than 2^32 points does not overflow, and that the
+// median filter and the cs2 recomputation give the same results beyond 2^32 points as on a small table. The large
+// quantities are sparse mappings of which only a block of Ye planes is touched, so the test runs in a few megabytes.
+
+// Needed for MAP_ANONYMOUS and MAP_NORESERVE
+#define _DEFAULT_SOURCE
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "cleaner.h"
+#include "interleaved_layout.h"
+#include "median_filter.h"
+#include "test_utils.h"
+#include "utils.h"
+
+#define N_POINTS_PER_AXIS (2048) ///< 2^33 points in total.
+#define BLOCK_RHO         (64)   ///< Density points of the block the kernels run on.
+#define BLOCK_TEMPERATURE (64)   ///< Temperature points of the block the kernels run on.
+#define BLOCK_YE          (8)    ///< Ye planes of the block the kernels run on, at the end of the Ye axis.
+
+static u64
+box_size(const index_box_t *box)
+{
+    return (box->hi[0] - box->lo[0]) * (box->hi[1] - box->lo[1]) * (box->hi[2] - box->lo[2]);
+}
+
+static void
+test_index(void)
+{
+    const u64 nr = N_POINTS_PER_AXIS, nt = N_POINTS_PER_AXIS, ny = N_POINTS_PER_AXIS;
+    CHECK(INDEX(0, 0, ny / 2) == (u64)1 << 32);
+    CHECK(INDEX(nr - 1, nt - 1, ny - 1) == nr * nt * ny - 1);
+    CHECK(INDEX(nr - 1, nt - 1, ny - 1) > UINT32_MAX);
+}
+
+static void
+test_filter_box(const stellar_collapse_eos *table)
+{
+    options_t   opts = {0};
+    index_box_t box  = select_filter_box(table, &opts);
+    CHECK(box_size(&box) == (u64)1 << 33);
+
+    // Upper half of the Ye axis, which alone has 2^32 points
+    opts.use_roi = true;
+    for(int axis = 0; axis < 3; axis++) {
+        opts.roi_min[axis] = axis < 2 ? 0 : table->ye[N_POINTS_PER_AXIS / 2];
+        opts.roi_max[axis] = HUGE_VAL;
+    }
+    box = select_filter_box(table, &opts);
+    CHECK(box.lo[2] == N_POINTS_PER_AXIS / 2 && box.hi[2] == N_POINTS_PER_AXIS);
+    CHECK(box_size(&box) == (u64)1 << 32);
+}
+
+static void
+test_filter_tiles(void)
+{
+    const u64         n        = N_POINTS_PER_AXIS;
+    const index_box_t interior = {
+        {MF_W,     MF_W,     MF_W    },
+        {n - MF_W, n - MF_W, n - MF_W},
+    };
+    const u64 edges[3] = {2, 4, 8};
+    for(int e = 0; e < 3; e++) {
+        // The tiles must cover the interior exactly once
+        const u64 n_tiles = count_median_filter_tiles(&interior, edges[e]);
+        u64       covered = 0;
+        for(u64 tile = 0; tile < n_tiles; tile++) {
+            const index_box_t t = get_median_filter_tile(&interior, edges[e], tile);
+            CHECK(t.lo[1] < t.hi[1] && t.hi[1] <= interior.hi[1] && t.lo[2] < t.hi[2] && t.hi[2] <= interior.hi[2]);
+            covered += box_size(&t);
+        }
+        CHECK(covered == box_size(&interior));
+        CHECK(covered > UINT32_MAX);
+
+        const index_box_t last = get_median_filter_tile(&interior, edges[e], n_tiles - 1);
+        CHECK(last.hi[1] == interior.hi[1] && last.hi[2] == interior.hi[2]);
+    }
+}
+
+static void
+test_interleaved_offsets(const stellar_collapse_eos *table)
+{
+    const stellar_collapse_eos_quantity qtys[3] = {eos_logpress, eos_logenergy, eos_cs2};
+    for(int tile = 1; tile <= 8; tile *= 2) {
+        const interleaved_layout layout = make_interleaved_layout(table, qtys, 3, true, tile);
+        const i32                n      = N_POINTS_PER_AXIS;
+        const u64                last   = interleaved_record_offset(&layout, n - 1, n - 1, n - 1);
+        CHECK(last > UINT32_MAX);
+        CHECK(last + layout.stride <= interleaved_layout_size(&layout));
+        CHECK(interleaved_layout_size(&layout) == ((u64)1 << 33) * layout.stride);
+    }
+}
+
+static u64
+point_index(const stellar_collapse_eos *table, const i32 ir, const i32 it, const i32 iy)
+{
+    const u64 nr = table->n_rho, nt = table->n_temperature;
+    return INDEX(ir, it, iy);
+}
+
+// Smooth values as a function of the position in the block, with an outlier every 97 points in the derivatives
+static f64
+block_value(const int qty, const i32 ir, const i32 it, const i32 iy)
+{
+    const f64 x = 1.0 + 0.01 * ir + 0.02 * it + 0.03 * iy;
+    if(qty == eos_logpress || qty == eos_logenergy) {
+        return (qty == eos_logpress ? 20.0 : 19.0) + x;
+    }
+    const f64 v = (1.0 + 0.1 * qty) * x;
+    return (ir + BLOCK_RHO * (it + BLOCK_TEMPERATURE * iy)) % 97 == 0 ? 50.0 * v : v;
+}
+
+static void
+test_kernels(const stellar_collapse_eos *axes)
+{
+    const stellar_collapse_eos_quantity qtys[5]   = {eos_logpress, eos_logenergy, eos_dpdrhoe, eos_dpderho, eos_cs2};
+    const stellar_collapse_eos_quantity filter[2] = {eos_dpdrhoe, eos_dpderho};
+    const u64                           n_points  = (u64)1 << 33;
+    const i32                           iy_offset = N_POINTS_PER_AXIS - BLOCK_YE;
+
+    stellar_collapse_eos large = *axes;
+    for(int q = 0; q < 5; q++) {
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+        void     *data  = mmap(NULL, sizeof(f64) * n_points, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if(data == MAP_FAILED) {
+            printf("Skipping the kernels: could not map %" PRIu64 " points\n", n_points);
+            for(int p = 0; p < q; p++) {
+                munmap(large.data[qtys[p]], sizeof(f64) * n_points);
+            }
+            return;
+        }
+        large.data[qtys[q]] = data;
+    }
+
+    // The same block of points, at the end of the large table and in a small table
+    stellar_collapse_eos small = {0};
+    small.n_rho                = BLOCK_RHO;
+    small.n_temperature        = BLOCK_TEMPERATURE;
+    small.n_ye                 = BLOCK_YE;
+    small.log10_rho            = axes->log10_rho;
+    small.log10_temperature    = axes->log10_temperature;
+    small.ye                   = axes->ye + iy_offset;
+    for(int q = 0; q < 5; q++) {
+        small.data[qtys[q]] = malloc_or_error(sizeof(f64) * BLOCK_RHO * BLOCK_TEMPERATURE * BLOCK_YE);
+        for(i32 iy = 0; iy < BLOCK_YE; iy++) {
+            for(i32 it = 0; it < BLOCK_TEMPERATURE; it++) {
+                for(i32 ir = 0; ir < BLOCK_RHO; ir++) {
+                    const f64 v                                                      = block_value(qtys[q], ir, it, iy);
+                    small.data[qtys[q]][point_index(&small, ir, it, iy)]             = v;
+                    large.data[qtys[q]][point_index(&large, ir, it, iy + iy_offset)] = v;
+                }
+            }
+        }
+    }
+
+    // Boxes in the interior of the block, so that both tables see the same windows
+    const index_box_t small_box = {
+        {MF_W,             MF_W,                     MF_W           },
+        {BLOCK_RHO - MF_W, BLOCK_TEMPERATURE - MF_W, BLOCK_YE - MF_W},
+    };
+    const index_box_t large_box = {
+        {small_box.lo[0], small_box.lo[1], small_box.lo[2] + iy_offset},
+        {small_box.hi[0], small_box.hi[1], small_box.hi[2] + iy_offset},
+    };
+    CHECK(point_index(&large, 0, 0, large_box.lo[2]) > UINT32_MAX);
+
+    u64 small_replaced[2] = {0, 0}, large_replaced[2] = {0, 0};
+    apply_median_filter_to_quantities(&small, filter, 2, &small_box, false, small_replaced, NULL, NULL);
+    apply_median_filter_to_quantities(&large, filter, 2, &large_box, false, large_replaced, NULL, NULL);
+    const cs2_limits_report small_report = recompute_cs2_in_box(&small, &small_box);
+    const cs2_limits_report large_report = recompute_cs2_in_box(&large, &large_box);
+    CHECK(small_replaced[0] > 0 && small_replaced[1] > 0);
+    CHECK(small_replaced[0] == large_replaced[0] && small_replaced[1] == large_replaced[1]);
+    CHECK(small_report.n_negative == large_report.n_negative);
+    CHECK(small_report.n_superluminal == large_report.n_superluminal);
+
+    u64 n_different = 0;
+    for(int q = 0; q < 5; q++) {
+        for(i32 iy = 0; iy < BLOCK_YE; iy++) {
+            for(i32 it = 0; it < BLOCK_TEMPERATURE; it++) {
+                for(i32 ir = 0; ir < BLOCK_RHO; ir++) {
+                    const f64 v  = small.data[qtys[q]][point_index(&small, ir, it, iy)];
+                    n_different += large.data[qtys[q]][point_index(&large, ir, it, iy + iy_offset)] != v;
+                }
+            }
+        }
+    }
+    CHECK(n_different == 0);
+
+    for(int q = 0; q < 5; q++) {
+        munmap(large.data[qtys[q]], sizeof(f64) * n_points);
+        free(small.data[qtys[q]]);
+    }
+}
+
+int
+main(void)
+{
+    stellar_collapse_eos table = {0};
+    table.n_rho                = N_POINTS_PER_AXIS;
+    table.n_temperature        = N_POINTS_PER_AXIS;
+    table.n_ye                 = N_POINTS_PER_AXIS;
+    table.log10_rho            = malloc_or_error(sizeof(f64) * N_POINTS_PER_AXIS);
+    table.log10_temperature    = malloc_or_error(sizeof(f64) * N_POINTS_PER_AXIS);
+    table.ye                   = malloc_or_error(sizeof(f64) * N_POINTS_PER_AXIS);
+    for(int i = 0; i < N_POINTS_PER_AXIS; i++) {
+        table.log10_rho[i]         = 3.0 + 12.0 * i / (N_POINTS_PER_AXIS - 1);
+        table.log10_temperature[i] = -2.0 + 4.0 * i / (N_POINTS_PER_AXIS - 1);
+        table.ye[i]                = 0.05 + 0.5 * i / (N_POINTS_PER_AXIS - 1);
+    }
+
+    test_index();
+    test_filter_box(&table);
+    test_filter_tiles();
+    test_interleaved_offsets(&table);
+    test_kernels(&table);
+
+    free(table.log10_rho);
+    free(table.log10_temperature);
+    free(table.ye);
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed for a table with %" PRIu64 " points\n", (u64)1 << 33);
+    return EXIT_SUCCESS;
+}
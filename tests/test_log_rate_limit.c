@@ -0,0 +1,96 @@
+// Checks that the counts of rate-limited call sites start over at every flush, also for call sites below the limit,
+// and that warnings suppressed before a flush inside a parallel region are reported by the next serial flush.
+#ifdef _OPENMP
+#    include <omp.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_utils.h"
+#include "utils.h"
+
+#define LOG_PATH "test_log_rate_limit.log"
+
+static void
+warn_below_limit(void)
+{
+    WARN_RATE_LIMITED("below limit\n");
+}
+
+static void
+warn_above_limit(void)
+{
+    WARN_RATE_LIMITED("above limit\n");
+}
+
+// Counts the lines of the log that contain a string
+static int
+count_lines(const char *text)
+{
+    FILE *fp = fopen(LOG_PATH, "r");
+    if(!fp) {
+        return -1;
+    }
+    char line[256];
+    int  count = 0;
+    while(fgets(line, sizeof(line), fp)) {
+        count += strstr(line, text) != NULL;
+    }
+    fclose(fp);
+    return count;
+}
+
+int
+main(void)
+{
+    // Warnings go to stderr, which is captured in a file
+    if(!freopen(LOG_PATH, "w", stderr)) {
+        fprintf(stdout, "Could not redirect standard error to '%s'\n", LOG_PATH);
+        return EXIT_FAILURE;
+    }
+
+    // A call site below the limit at a flush can log LOG_RATE_LIMIT more messages after it
+    for(int n = 0; n < LOG_RATE_LIMIT / 2; n++) {
+        warn_below_limit();
+    }
+    flush_log();
+    for(int n = 0; n < LOG_RATE_LIMIT; n++) {
+        warn_below_limit();
+    }
+    flush_log();
+    CHECK(count_lines("below limit") == LOG_RATE_LIMIT / 2 + LOG_RATE_LIMIT);
+    CHECK(count_lines("suppressed") == 0);
+
+    // A flush inside a parallel region leaves the summary to the serial flush
+#ifdef _OPENMP
+#    pragma omp parallel num_threads(2)
+#endif
+    {
+#ifdef _OPENMP
+#    pragma omp single
+#endif
+        for(int n = 0; n < LOG_RATE_LIMIT + 5; n++) {
+            warn_above_limit();
+        }
+        flush_log();
+    }
+    flush_log();
+    CHECK(count_lines("above limit") == LOG_RATE_LIMIT);
+    CHECK(count_lines("5 more similar warnings suppressed") == 1);
+
+    // The summary is only reported once, and the call site starts over
+    warn_above_limit();
+    flush_log();
+    CHECK(count_lines("above limit") == LOG_RATE_LIMIT + 1);
+    CHECK(count_lines("suppressed") == 1);
+
+    remove(LOG_PATH);
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed for the rate-limited warnings\n");
+    return EXIT_SUCCESS;
+}
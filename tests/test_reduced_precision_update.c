@@ -0,0 +1,154 @@
+// Checks that tables with quantized or f32 quantities are refused by '--in-place' and '--copy-through', which would
+// write f64 values into the reduced datasets, and by the patch options, which would read the stored values directly.
+// The refused file must read back unchanged.
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+#include "precision.h"
+#include "stellar_collapse_eos.h"
+#include "test_utils.h"
+#include "utils.h"
+
+#define TABLE_PATH      "test_reduced_precision_update.h5"
+#define COPY_TABLE_PATH "test_reduced_precision_update_copy.h5"
+#define N_RHO           (12)
+#define N_TEMPERATURE   (10)
+#define N_YE            (8)
+
+static jmp_buf trap;
+
+static stellar_collapse_eos *
+make_table(void)
+{
+    stellar_collapse_eos *table = malloc_or_error(sizeof(stellar_collapse_eos));
+    memset(table, 0, sizeof(stellar_collapse_eos));
+    table->n_rho             = N_RHO;
+    table->n_temperature     = N_TEMPERATURE;
+    table->n_ye              = N_YE;
+    table->log10_rho         = malloc_or_error(sizeof(f64) * N_RHO);
+    table->log10_temperature = malloc_or_error(sizeof(f64) * N_TEMPERATURE);
+    table->ye                = malloc_or_error(sizeof(f64) * N_YE);
+    for(int i = 0; i < N_RHO; i++) {
+        table->log10_rho[i] = 3.0 + i;
+    }
+    for(int i = 0; i < N_TEMPERATURE; i++) {
+        table->log10_temperature[i] = -2.0 + 0.4 * i;
+    }
+    for(int i = 0; i < N_YE; i++) {
+        table->ye[i] = 0.05 + 0.05 * i;
+    }
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        table->data[n] = malloc_or_error(sizeof(f64) * N_RHO * N_TEMPERATURE * N_YE);
+        for(int iy = 0; iy < N_YE; iy++) {
+            for(int it = 0; it < N_TEMPERATURE; it++) {
+                for(int ir = 0; ir < N_RHO; ir++) {
+                    table->data[n][ir + N_RHO * (it + N_TEMPERATURE * iy)] = 1.0 + 0.1 * n + 0.01 * (ir + it + iy);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+static bool
+tables_are_identical(const stellar_collapse_eos *table1, const stellar_collapse_eos *table2)
+{
+    const usize size = sizeof(f64) * N_RHO * N_TEMPERATURE * N_YE;
+    for(int n = 0; n < number_of_eos_quantities; n++) {
+        if(memcmp(table1->data[n], table2->data[n], size) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the error code raised by the update, or SUCCESS if it was not refused
+static error_t
+try_update(stellar_collapse_eos *table, const bool in_place)
+{
+    if(setjmp(trap) != 0) {
+        set_error_trap(NULL);
+        return last_error_code();
+    }
+    set_error_trap(&trap);
+    if(in_place) {
+        update_stellar_collapse_eos_table_in_place(table, TABLE_PATH);
+    }
+    else {
+        write_stellar_collapse_eos_table_copy_through(table, TABLE_PATH, COPY_TABLE_PATH);
+    }
+    set_error_trap(NULL);
+    return SUCCESS;
+}
+
+static error_t
+try_parse(const char *mode, const char *value)
+{
+    char     *argv[] = {"eos_cleaner", (char *)mode, (char *)value, TABLE_PATH};
+    const int argc   = value ? 4 : 3;
+    if(!value) {
+        argv[2] = TABLE_PATH;
+    }
+    if(setjmp(trap) != 0) {
+        set_error_trap(NULL);
+        return last_error_code();
+    }
+    set_error_trap(&trap);
+    parse_cmd_args(argc, argv);
+    set_error_trap(NULL);
+    return SUCCESS;
+}
+
+int
+main(void)
+{
+    stellar_collapse_eos *table = make_table();
+
+    precision_spec specs[number_of_eos_quantities] = {{0}};
+    parse_precision_spec("Xa=quant:abs=1e-6", specs);
+    parse_precision_spec("cs2=f32:rel=1e-6", specs);
+    write_stellar_collapse_eos_table_reduced(table, specs, TABLE_PATH);
+    free_stellar_collapse_eos_table(table);
+    CHECK(is_reduced_precision_table_file(TABLE_PATH));
+
+    stellar_collapse_eos *original = read_stellar_collapse_eos_table(TABLE_PATH);
+    stellar_collapse_eos *cleaned  = read_stellar_collapse_eos_table(TABLE_PATH);
+    cleaned->data[eos_Xa][0]      += 0.5;
+    cleaned->data[eos_cs2][0]     += 0.5;
+    mark_ye_planes_modified(cleaned, eos_Xa, 0, 1);
+    mark_ye_planes_modified(cleaned, eos_cs2, 0, 1);
+
+    // Both the command line and the writers refuse the file, before anything is written
+    printf("Expecting six errors about reduced precision quantities:\n");
+    CHECK(try_parse("--in-place", NULL) == UNKNOWN_OPTION);
+    CHECK(try_parse("--copy-through", NULL) == UNKNOWN_OPTION);
+    CHECK(try_parse("--patch", COPY_TABLE_PATH) == UNKNOWN_OPTION);
+    CHECK(try_parse("--apply-patch", COPY_TABLE_PATH) == UNKNOWN_OPTION);
+    CHECK(try_update(cleaned, true) == UNSUPPORTED_FEATURE);
+    CHECK(try_update(cleaned, false) == UNSUPPORTED_FEATURE);
+
+    FILE *copy = fopen(COPY_TABLE_PATH, "rb");
+    CHECK(copy == NULL);
+    if(copy) {
+        fclose(copy);
+    }
+
+    stellar_collapse_eos *read_back = read_stellar_collapse_eos_table(TABLE_PATH);
+    CHECK(tables_are_identical(original, read_back));
+
+    free_stellar_collapse_eos_table(original);
+    free_stellar_collapse_eos_table(cleaned);
+    free_stellar_collapse_eos_table(read_back);
+    remove(TABLE_PATH);
+    remove(COPY_TABLE_PATH);
+
+    if(failures) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed for in-place, copy-through, and patch updates of a reduced precision table\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file test_utils.h
+ * @author Leo Werneck
+ *
+ * @brief Checks shared by the unit tests in tests/.
+ *
+ * Failed checks are counted rather than aborting the test, so that one run reports all of them. They are printed to
+ * standard output, since some tests capture standard error.
+ */
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H
+
+#include <stdio.h>
+
+static int failures = 0; ///< Number of failed checks.
+
+/**
+ * @brief Counts and reports a failed check.
+ */
+#define CHECK(condition)                                                         \
+    do {                                                                         \
+        if(!(condition)) {                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                          \
+        }                                                                        \
+    } while(0)
+
+#endif // TEST_UTILS_H